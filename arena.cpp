@@ -0,0 +1,378 @@
+#include "arena.h"
+#include "bitops.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <unordered_map>
+
+namespace {
+    constexpr size_t BLOCK_ALIGNMENT = alignof(std::max_align_t);
+    // Slots moved between a thread's free list and the pool at a time
+    constexpr size_t REFILL_COUNT = 32;
+    constexpr size_t MAX_CACHED_SLOTS = 2 * REFILL_COUNT;
+
+    size_t SizeClassIndex(size_t slot_size) {
+        return CountTrailingZeros(slot_size) - CountTrailingZeros(FixedPool::MIN_SLOT_SIZE);
+    }
+
+    size_t SlotSize(size_t bytes, size_t alignment) {
+        return RoundUpToPowerOfTwo(std::max({bytes, alignment, FixedPool::MIN_SLOT_SIZE}));
+    }
+
+    bool IsPooled(size_t slot_size) {
+        return slot_size != 0 && slot_size <= FixedPool::MAX_SLOT_SIZE;
+    }
+}
+
+double AllocatorStats::Fragmentation() const {
+    if (bytes_reserved == 0) {
+        return 0;
+    }
+    return 1 - static_cast<double>(std::min(bytes_in_use, bytes_reserved)) / static_cast<double>(bytes_reserved);
+}
+
+Arena::Arena(size_t initial_block_size, std::pmr::memory_resource *upstream)
+    : upstream_(upstream),
+      initial_block_size_(std::clamp<size_t>(RoundUpToPowerOfTwo(initial_block_size), sizeof(Block), MAX_BLOCK_SIZE)),
+      next_block_size_(initial_block_size_) {
+
+}
+
+Arena::~Arena() {
+    Release();
+}
+
+void Arena::Release() {
+    while (blocks_ != nullptr) {
+        Block *next = blocks_->next;
+        upstream_->deallocate(blocks_, blocks_->size, BLOCK_ALIGNMENT);
+        blocks_ = next;
+    }
+    current_ = 0;
+    end_ = 0;
+    next_block_size_ = initial_block_size_;
+    stats_ = AllocatorStats{};
+}
+
+AllocatorStats Arena::Stats() const {
+    return stats_;
+}
+
+void Arena::AddBlock(size_t bytes, size_t alignment) {
+    // Header, worst-case padding and the request itself must fit
+    size_t padding = alignment > BLOCK_ALIGNMENT ? alignment : 0;
+    size_t needed = sizeof(Block) + padding + bytes;
+    if (needed < bytes) {
+        throw std::bad_alloc();
+    }
+    size_t size = RoundUpToPowerOfTwo(std::max(needed, next_block_size_));
+    if (size == 0) {
+        throw std::bad_alloc();
+    }
+    void *memory = upstream_->allocate(size, BLOCK_ALIGNMENT);
+    blocks_ = new (memory) Block{blocks_, size};
+    current_ = reinterpret_cast<uintptr_t>(memory) + sizeof(Block);
+    end_ = reinterpret_cast<uintptr_t>(memory) + size;
+    next_block_size_ = std::min(next_block_size_ * 2, MAX_BLOCK_SIZE);
+    stats_.bytes_reserved += size;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+    uintptr_t start = AlignUp(current_, alignment);
+    if (blocks_ == nullptr || start < current_ || start > end_ || end_ - start < bytes) {
+        AddBlock(bytes, alignment);
+        start = AlignUp(current_, alignment);
+    }
+    current_ = start + bytes;
+    ++stats_.allocations;
+    stats_.bytes_in_use += bytes;
+    return reinterpret_cast<void *>(start);
+}
+
+void Arena::do_deallocate(void *, size_t, size_t) {
+    ++stats_.deallocations;
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+// Local state of one thread for every pool it used, keyed by pool id rather than address so
+// a new pool at the address of a destroyed one never sees stale slots. On thread exit the
+// slots and counts go back to the pools that are still alive; entries of pools destroyed
+// meanwhile are dropped whenever the thread starts using another pool.
+struct FixedPool::ThreadCache {
+    std::unordered_map<uint64_t, LocalState> pools;
+    uint64_t last_id = 0;
+    LocalState *last_state = nullptr;
+
+    ThreadCache();
+    ~ThreadCache();
+
+    void DropDeadPools();
+};
+
+namespace {
+    std::atomic<uint64_t> next_pool_id = 1;
+
+    // Trivially destructible, so it stays readable while the thread's cache is destroyed and
+    // afterwards, e.g. from the destructor of a static pool or of a thread_local container
+    thread_local bool thread_cache_destroyed = false;
+
+    std::mutex &LivePoolsMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::unordered_map<uint64_t, FixedPool *> &LivePools() {
+        static std::unordered_map<uint64_t, FixedPool *> pools;
+        return pools;
+    }
+
+    void AddStats(AllocatorStats &to, const AllocatorStats &from) {
+        // Pending counts are deltas; a negative one wraps around and cancels out here
+        to.allocations += from.allocations;
+        to.deallocations += from.deallocations;
+        to.bytes_in_use += from.bytes_in_use;
+        to.bytes_reserved += from.bytes_reserved;
+    }
+}
+
+thread_local FixedPool::ThreadCache *FixedPool::local_cache_ = nullptr;
+
+FixedPool::ThreadCache::ThreadCache() {
+    local_cache_ = this;
+}
+
+FixedPool::ThreadCache::~ThreadCache() {
+    local_cache_ = nullptr;
+    thread_cache_destroyed = true;
+    std::lock_guard registry_lock(LivePoolsMutex());
+    for (auto &[id, state] : pools) {
+        auto pool = LivePools().find(id);
+        if (pool == LivePools().end()) {
+            continue;
+        }
+        std::lock_guard lock(pool->second->mutex_);
+        for (size_t size_class = 0; size_class < NUM_SIZE_CLASSES; ++size_class) {
+            pool->second->Drain(size_class, state.lists[size_class]);
+        }
+        pool->second->Publish(state.pending);
+    }
+}
+
+void FixedPool::ThreadCache::DropDeadPools() {
+    std::lock_guard registry_lock(LivePoolsMutex());
+    std::erase_if(pools, [](const auto &entry) {
+        return !LivePools().contains(entry.first);
+    });
+    last_id = 0;
+    last_state = nullptr;
+}
+
+FixedPool::FixedPool(std::pmr::memory_resource *upstream)
+    : upstream_(upstream), id_(next_pool_id.fetch_add(1, std::memory_order_relaxed)) {
+    std::lock_guard registry_lock(LivePoolsMutex());
+    LivePools().emplace(id_, this);
+}
+
+FixedPool::~FixedPool() {
+    {
+        std::lock_guard registry_lock(LivePoolsMutex());
+        LivePools().erase(id_);
+    }
+    if (ThreadCache *cache = LocalCache(false)) {
+        if (cache->last_id == id_) {
+            cache->last_id = 0;
+            cache->last_state = nullptr;
+        }
+        cache->pools.erase(id_);
+    }
+    for (const Chunk &chunk : chunks_) {
+        upstream_->deallocate(chunk.ptr, chunk.size, chunk.alignment);
+    }
+}
+
+AllocatorStats FixedPool::Stats() const {
+    std::lock_guard lock(mutex_);
+    AllocatorStats stats = stats_;
+    if (const ThreadCache *cache = LocalCache(false)) {
+        if (auto state = cache->pools.find(id_); state != cache->pools.end()) {
+            AddStats(stats, state->second.pending);
+        }
+    }
+    return stats;
+}
+
+FixedPool::ThreadCache *FixedPool::LocalCache(bool create) {
+    if (local_cache_ != nullptr || thread_cache_destroyed || !create) {
+        return local_cache_;
+    }
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+FixedPool::LocalState *FixedPool::Local() {
+    ThreadCache *cache = LocalCache(true);
+    if (cache == nullptr) {
+        return nullptr;
+    }
+    if (cache->last_id != id_) {
+        auto state = cache->pools.find(id_);
+        if (state == cache->pools.end()) {
+            cache->DropDeadPools();
+            state = cache->pools.try_emplace(id_).first;
+        }
+        cache->last_state = &state->second;
+        cache->last_id = id_;
+    }
+    return cache->last_state;
+}
+
+void FixedPool::Publish(AllocatorStats &pending) {
+    AddStats(stats_, pending);
+    pending = AllocatorStats{};
+}
+
+void FixedPool::Refill(size_t size_class, FreeList &list) {
+    size_t slot_size = MIN_SLOT_SIZE << size_class;
+    SizeClass &shared = classes_[size_class];
+    while (shared.free.head != nullptr && list.count < REFILL_COUNT) {
+        Slot *slot = shared.free.head;
+        shared.free.head = slot->next;
+        --shared.free.count;
+        slot->next = list.head;
+        list.head = slot;
+        ++list.count;
+    }
+    if (list.count > 0) {
+        return;
+    }
+    if (shared.unused == shared.unused_end) {
+        // Grow before allocating so push_back cannot throw and leak the chunk; growing
+        // geometrically keeps that linear overall
+        if (chunks_.size() == chunks_.capacity()) {
+            chunks_.reserve(2 * chunks_.size() + 1);
+        }
+        void *memory = upstream_->allocate(CHUNK_SIZE, slot_size);
+        chunks_.push_back(Chunk{memory, CHUNK_SIZE, slot_size});
+        shared.unused = static_cast<char *>(memory);
+        shared.unused_end = shared.unused + CHUNK_SIZE;
+        stats_.bytes_reserved += CHUNK_SIZE;
+    }
+    while (shared.unused != shared.unused_end && list.count < REFILL_COUNT) {
+        list.head = new (shared.unused) Slot{list.head};
+        ++list.count;
+        shared.unused += slot_size;
+    }
+}
+
+void FixedPool::Drain(size_t size_class, FreeList &list) {
+    SizeClass &shared = classes_[size_class];
+    while (list.head != nullptr) {
+        Slot *slot = list.head;
+        list.head = slot->next;
+        slot->next = shared.free.head;
+        shared.free.head = slot;
+        ++shared.free.count;
+    }
+    list.count = 0;
+}
+
+void *FixedPool::do_allocate(size_t bytes, size_t alignment) {
+    LocalState *local = Local();
+    if (local == nullptr) {
+        return AllocateShared(bytes, alignment);
+    }
+    size_t slot_size = SlotSize(bytes, alignment);
+    void *result;
+    if (IsPooled(slot_size)) {
+        FreeList &list = local->lists[SizeClassIndex(slot_size)];
+        if (list.head == nullptr) {
+            std::lock_guard lock(mutex_);
+            Refill(SizeClassIndex(slot_size), list);
+            Publish(local->pending);
+        }
+        result = list.head;
+        list.head = list.head->next;
+        --list.count;
+    } else {
+        result = upstream_->allocate(bytes, alignment);
+        local->pending.bytes_reserved += bytes;
+    }
+    ++local->pending.allocations;
+    local->pending.bytes_in_use += bytes;
+    return result;
+}
+
+void FixedPool::do_deallocate(void *ptr, size_t bytes, size_t alignment) {
+    LocalState *local = Local();
+    if (local == nullptr) {
+        return DeallocateShared(ptr, bytes, alignment);
+    }
+    size_t slot_size = SlotSize(bytes, alignment);
+    ++local->pending.deallocations;
+    local->pending.bytes_in_use -= bytes;
+    if (!IsPooled(slot_size)) {
+        upstream_->deallocate(ptr, bytes, alignment);
+        local->pending.bytes_reserved -= bytes;
+        return;
+    }
+    FreeList &list = local->lists[SizeClassIndex(slot_size)];
+    list.head = new (ptr) Slot{list.head};
+    ++list.count;
+    if (list.count > MAX_CACHED_SLOTS) {
+        // Keep a batch for this thread, hand the rest to the others
+        FreeList surplus;
+        while (list.count > REFILL_COUNT) {
+            Slot *slot = list.head;
+            list.head = slot->next;
+            --list.count;
+            slot->next = surplus.head;
+            surplus.head = slot;
+            ++surplus.count;
+        }
+        std::lock_guard lock(mutex_);
+        Drain(SizeClassIndex(slot_size), surplus);
+        Publish(local->pending);
+    }
+}
+
+void *FixedPool::AllocateShared(size_t bytes, size_t alignment) {
+    size_t slot_size = SlotSize(bytes, alignment);
+    std::lock_guard lock(mutex_);
+    void *result;
+    if (IsPooled(slot_size)) {
+        FreeList list;
+        Refill(SizeClassIndex(slot_size), list);
+        result = list.head;
+        list.head = list.head->next;
+        Drain(SizeClassIndex(slot_size), list);
+    } else {
+        result = upstream_->allocate(bytes, alignment);
+        stats_.bytes_reserved += bytes;
+    }
+    ++stats_.allocations;
+    stats_.bytes_in_use += bytes;
+    return result;
+}
+
+void FixedPool::DeallocateShared(void *ptr, size_t bytes, size_t alignment) {
+    size_t slot_size = SlotSize(bytes, alignment);
+    std::lock_guard lock(mutex_);
+    ++stats_.deallocations;
+    stats_.bytes_in_use -= bytes;
+    if (!IsPooled(slot_size)) {
+        upstream_->deallocate(ptr, bytes, alignment);
+        stats_.bytes_reserved -= bytes;
+        return;
+    }
+    FreeList list;
+    list.head = new (ptr) Slot{nullptr};
+    list.count = 1;
+    Drain(SizeClassIndex(slot_size), list);
+}
+
+bool FixedPool::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+struct AllocatorStats {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    // Bytes handed out to callers, as requested
+    uint64_t bytes_in_use = 0;
+    // Bytes currently held from the upstream resource
+    uint64_t bytes_reserved = 0;
+
+    // Share of the reserved bytes not handed out: alignment padding, rounding up to a size
+    // class, unused block tails and cached free slots
+    double Fragmentation() const;
+};
+
+// Monotonic bump allocator over a chain of blocks. Deallocation is a no-op; memory is given
+// back by Release() or the destructor. Block sizes are powers of two that double up to
+// MAX_BLOCK_SIZE; a larger request gets a block of its own. Not thread-safe.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 20;
+
+    explicit Arena(size_t initial_block_size = DEFAULT_BLOCK_SIZE,
+                   std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+    ~Arena() override;
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void Release();
+    // bytes_in_use only grows until Release(), since nothing is reused before that
+    AllocatorStats Stats() const;
+
+private:
+    struct Block {
+        Block *next;
+        size_t size;
+    };
+
+    std::pmr::memory_resource *upstream_;
+    size_t initial_block_size_;
+    size_t next_block_size_;
+    Block *blocks_ = nullptr;
+    uintptr_t current_ = 0;
+    uintptr_t end_ = 0;
+    AllocatorStats stats_;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    void AddBlock(size_t bytes, size_t alignment);
+};
+
+// Pool of power-of-two size classes from MIN_SLOT_SIZE to MAX_SLOT_SIZE, each slot aligned to
+// its size. Every thread keeps its own free lists, so allocation and deallocation take the
+// pool lock only to move a batch of slots; a slot may be freed by any thread. Requests above
+// MAX_SLOT_SIZE (or with a stronger alignment) go straight to the upstream resource.
+// Thread-safe; all slots return to the upstream resource when the pool is destroyed.
+// Each thread's counts reach Stats() when it next exchanges a batch with the pool, so from
+// another thread they may lag by about a batch per thread.
+class FixedPool : public std::pmr::memory_resource {
+public:
+    static constexpr size_t MIN_SLOT_SIZE = 8;
+    static constexpr size_t MAX_SLOT_SIZE = 4096;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    explicit FixedPool(std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+    ~FixedPool() override;
+
+    FixedPool(const FixedPool &) = delete;
+    FixedPool &operator=(const FixedPool &) = delete;
+
+    AllocatorStats Stats() const;
+
+private:
+    static constexpr size_t NUM_SIZE_CLASSES = 10;
+
+    struct Slot {
+        Slot *next;
+    };
+
+    struct FreeList {
+        Slot *head = nullptr;
+        size_t count = 0;
+    };
+
+    struct SizeClass {
+        FreeList free;
+        char *unused = nullptr;
+        char *unused_end = nullptr;
+    };
+
+    struct Chunk {
+        void *ptr;
+        size_t size;
+        size_t alignment;
+    };
+
+    // Free lists and not yet published counts of one thread
+    struct LocalState {
+        std::array<FreeList, NUM_SIZE_CLASSES> lists;
+        AllocatorStats pending;
+    };
+
+    struct ThreadCache;
+
+    // The calling thread's cache while it exists
+    static thread_local ThreadCache *local_cache_;
+
+    std::pmr::memory_resource *upstream_;
+    uint64_t id_;
+    mutable std::mutex mutex_;
+    std::array<SizeClass, NUM_SIZE_CLASSES> classes_;
+    std::vector<Chunk> chunks_;
+    AllocatorStats stats_;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    // The calling thread's cache, created on first use unless `create` is false; nullptr once
+    // the thread's thread_local objects are being destroyed
+    static ThreadCache *LocalCache(bool create);
+    // nullptr when the thread has no cache any more; such calls take the lock every time
+    LocalState *Local();
+    void *AllocateShared(size_t bytes, size_t alignment);
+    void DeallocateShared(void *ptr, size_t bytes, size_t alignment);
+    // Expect mutex_ to be held
+    void Refill(size_t size_class, FreeList &list);
+    void Drain(size_t size_class, FreeList &list);
+    void Publish(AllocatorStats &pending);
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Timing shared by the standalone benchmarks. Results are stored to sink so the measured
+// work cannot be optimised away, and each measurement keeps the best of REPEATS runs to
+// filter out interference from the rest of the machine.
+inline constexpr int REPEATS = 20;
+
+inline volatile uint64_t sink;
+
+// Shortest wall time of `repeats` runs of function, in seconds
+template <typename Function>
+double MeasureBestSeconds(Function function, int repeats = REPEATS) {
+    double best = 0;
+    for (int repeat = 0; repeat < repeats; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = repeat == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+// Best rate of `repeats` runs of function processing `units` items, in billions per second
+template <typename Function>
+double MeasureBillionsPerSecond(size_t units, Function function, int repeats = REPEATS) {
+    return units / MeasureBestSeconds(function, repeats) / 1e9;
+}
@@ -0,0 +1,73 @@
+// Throughput of the bitops array kernels against loops over the per-element functions.
+// Build from the repository root:
+//   g++ -std=c++20 -O2 -I. benchmarks/bitops_benchmark.cpp bitops.cpp -o bitops_benchmark
+
+#include "benchmarks/benchmark.h"
+#include "bitops.h"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t WORDS = size_t{1} << 20;  // 8 MiB, larger than L2
+
+    // Best throughput of REPEATS runs, in GB/s of input
+    template <typename Function>
+    double MeasureGbPerSecond(Function function) {
+        return MeasureBillionsPerSecond(WORDS * sizeof(uint64_t), function);
+    }
+
+    void Report(const char *name, double per_element, double span) {
+        std::printf("%-24s per-element %7.2f GB/s   span %7.2f GB/s   x%.1f\n", name, per_element, span,
+                    span / per_element);
+    }
+}
+
+int main() {
+    std::mt19937_64 random(42);
+    std::vector<uint64_t> values(WORDS);
+    std::vector<uint64_t> result(WORDS);
+    for (uint64_t &value : values) {
+        value = random();
+    }
+
+    const CpuFeatures &features = GetCpuFeatures();
+    std::printf("popcnt=%d avx2=%d avx512bw=%d avx512vpopcntdq=%d\n", features.popcnt, features.avx2,
+                features.avx512bw, features.avx512vpopcntdq);
+
+    Report("PopcountSpan",
+           MeasureGbPerSecond([&] {
+               uint64_t total = 0;
+               for (uint64_t value : values) {
+                   total += CountSetBits(value);
+               }
+               sink = total;
+           }),
+           MeasureGbPerSecond([&] { sink = PopcountSpan(values); }));
+
+    Report("SwapBytesSpan",
+           MeasureGbPerSecond([&] {
+               for (size_t i = 0; i < WORDS; ++i) {
+                   result[i] = SwapBytes(values[i]);
+               }
+               sink = result[WORDS - 1];
+           }),
+           MeasureGbPerSecond([&] {
+               SwapBytesSpan(values, result);
+               sink = result[WORDS - 1];
+           }));
+
+    Report("ReverseBitsInBytesSpan",
+           MeasureGbPerSecond([&] {
+               for (size_t i = 0; i < WORDS; ++i) {
+                   result[i] = ReverseBitsInBytes(values[i]);
+               }
+               sink = result[WORDS - 1];
+           }),
+           MeasureGbPerSecond([&] {
+               ReverseBitsInBytesSpan(values, result);
+               sink = result[WORDS - 1];
+           }));
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Compressed size and decoding speed of every IntegerCodec on sequences shaped like real data.
+// Build from the repository root:
+//   g++ -std=c++20 -O2 -I. benchmarks/integer_codec_benchmark.cpp varint.cpp bitops.cpp -o integer_codec_benchmark
+
+#include "benchmarks/benchmark.h"
+#include "varint.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t VALUES = size_t{1} << 20;
+    constexpr int CODEC_REPEATS = 10;
+    constexpr IntegerCodec CODECS[] = {IntegerCodec::Varint, IntegerCodec::Delta, IntegerCodec::DeltaOfDelta,
+                                       IntegerCodec::GroupVarint, IntegerCodec::FrameOfReference};
+    constexpr const char *CODEC_NAMES[] = {"Varint", "Delta", "DeltaOfDelta", "GroupVarint", "FrameOfReference"};
+
+    void Run(const char *name, const std::function<uint64_t(std::mt19937_64 &, uint64_t)> &next) {
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> values(VALUES);
+        uint64_t previous = 0;
+        for (uint64_t &value : values) {
+            value = previous = next(random, previous);
+        }
+        std::printf("%s\n", name);
+        for (size_t codec = 0; codec < std::size(CODECS); ++codec) {
+            std::vector<uint8_t> encoded;
+            EncodeBlock(CODECS[codec], values, encoded);
+            std::vector<uint64_t> decoded(VALUES);
+            double best = MeasureBillionsPerSecond(
+                VALUES, [&] { sink = DecodeBlock(CODECS[codec], encoded.data(), encoded.size(), decoded); },
+                CODEC_REPEATS);
+            std::printf("  %-18s %6.2f bytes/value   decode %5.2f G values/s%s\n", CODEC_NAMES[codec],
+                        static_cast<double>(encoded.size()) / VALUES, best, decoded == values ? "" : "   MISMATCH");
+        }
+    }
+}
+
+int main() {
+    // Millisecond timestamps of a metric sampled every second with a little jitter
+    Run("timestamps, 1 s period with jitter", [](std::mt19937_64 &random, uint64_t previous) {
+        return previous == 0 ? 1700000000000 : previous + 1000 + random() % 5 - 2;
+    });
+    // Sorted document ids of a posting list with about one hit per 20 documents
+    Run("sorted ids, average gap 20", [](std::mt19937_64 &random, uint64_t previous) {
+        return previous + 1 + random() % 39;
+    });
+    // Small counters, e.g. per-interval event counts
+    Run("small counters < 1000", [](std::mt19937_64 &random, uint64_t) {
+        return random() % 1000;
+    });
+    // ZigZag-encoded signed changes of a slowly varying gauge
+    Run("zigzag gauge deltas", [](std::mt19937_64 &random, uint64_t) {
+        return ZigZagEncode(static_cast<int64_t>(random() % 2001) - 1000);
+    });
+    Run("random 32-bit ids", [](std::mt19937_64 &random, uint64_t) {
+        return random() >> 32;
+    });
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Throughput of the bulk multiplication kernels against loops over the per-element Multiply,
+// and of ConstantDivider against the div instruction.
+// Build from the repository root:
+//   g++ -std=c++20 -O2 -I. benchmarks/multiplication_benchmark.cpp multiplication.cpp bitops.cpp -o multiplication_benchmark
+
+#include "benchmarks/benchmark.h"
+#include "bitops.h"
+#include "multiplication.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t VALUES = size_t{1} << 20;
+
+    void Report(const char *name, const char *baseline_name, double baseline, double kernel, bool same) {
+        std::printf("%-20s %-14s %6.2f G/s   kernel %6.2f G/s   x%.1f%s\n", name, baseline_name, baseline, kernel,
+                    kernel / baseline, same ? "" : "   MISMATCH");
+    }
+}
+
+int main() {
+    std::mt19937_64 random(42);
+    std::vector<int32_t> a32(VALUES);
+    std::vector<int32_t> b32(VALUES);
+    std::vector<int64_t> a64(VALUES);
+    std::vector<int64_t> b64(VALUES);
+    std::vector<uint64_t> dividends(VALUES);
+    for (size_t i = 0; i < VALUES; ++i) {
+        a32[i] = static_cast<int32_t>(random());
+        b32[i] = static_cast<int32_t>(random());
+        a64[i] = static_cast<int64_t>(random());
+        b64[i] = static_cast<int64_t>(random());
+        dividends[i] = random();
+    }
+    std::vector<int64_t> expected(VALUES);
+    std::vector<int64_t> result(VALUES);
+    std::printf("avx2=%d\n", GetCpuFeatures().avx2);
+
+    double baseline = MeasureBillionsPerSecond(VALUES, [&] {
+        for (size_t i = 0; i < VALUES; ++i) {
+            expected[i] = Multiply(a32[i], b32[i]);
+        }
+        sink = expected[VALUES - 1];
+    });
+    double kernel = MeasureBillionsPerSecond(VALUES, [&] {
+        MultiplySpan(a32, b32, result);
+        sink = result[VALUES - 1];
+    });
+    Report("MultiplySpan", "Multiply loop", baseline, kernel, result == expected);
+
+    // Accumulators restart from zero every run, so both sides compute the same sums
+    baseline = MeasureBillionsPerSecond(VALUES, [&] {
+        std::fill(expected.begin(), expected.end(), 0);
+        for (size_t i = 0; i < VALUES; ++i) {
+            expected[i] += Multiply(a32[i], b32[i]);
+        }
+        sink = expected[VALUES - 1];
+    });
+    kernel = MeasureBillionsPerSecond(VALUES, [&] {
+        std::fill(result.begin(), result.end(), 0);
+        MultiplyAccumulate(a32, b32, result);
+        sink = result[VALUES - 1];
+    });
+    Report("MultiplyAccumulate32", "Multiply loop", baseline, kernel, result == expected);
+
+    baseline = MeasureBillionsPerSecond(VALUES, [&] {
+        std::fill(expected.begin(), expected.end(), 0);
+        for (size_t i = 0; i < VALUES; ++i) {
+            expected[i] = static_cast<int64_t>(static_cast<uint64_t>(expected[i]) +
+                                               static_cast<uint64_t>(a64[i]) * static_cast<uint64_t>(b64[i]));
+        }
+        sink = expected[VALUES - 1];
+    });
+    kernel = MeasureBillionsPerSecond(VALUES, [&] {
+        std::fill(result.begin(), result.end(), 0);
+        MultiplyAccumulate(a64, b64, result);
+        sink = result[VALUES - 1];
+    });
+    Report("MultiplyAccumulate64", "scalar loop", baseline, kernel, result == expected);
+
+    // The divisor is only known at run time, as it would be when read from a config
+    volatile uint64_t runtime_divisor = 1000000007;
+    uint64_t divisor = runtime_divisor;
+    ConstantDivider divider(divisor);
+    std::vector<uint64_t> expected_unsigned(VALUES);
+    std::vector<uint64_t> result_unsigned(VALUES);
+    baseline = MeasureBillionsPerSecond(VALUES, [&] {
+        for (size_t i = 0; i < VALUES; ++i) {
+            expected_unsigned[i] = dividends[i] % divisor;
+        }
+        sink = expected_unsigned[VALUES - 1];
+    });
+    kernel = MeasureBillionsPerSecond(VALUES, [&] {
+        divider.ModuloSpan(dividends, result_unsigned);
+        sink = result_unsigned[VALUES - 1];
+    });
+    Report("ModuloSpan", "div loop", baseline, kernel, result_unsigned == expected_unsigned);
+
+    baseline = MeasureBillionsPerSecond(VALUES, [&] {
+        for (size_t i = 0; i < VALUES; ++i) {
+            expected_unsigned[i] = dividends[i] / divisor;
+        }
+        sink = expected_unsigned[VALUES - 1];
+    });
+    kernel = MeasureBillionsPerSecond(VALUES, [&] {
+        divider.DivideSpan(dividends, result_unsigned);
+        sink = result_unsigned[VALUES - 1];
+    });
+    Report("DivideSpan", "div loop", baseline, kernel, result_unsigned == expected_unsigned);
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Decoding speed of DecodeVarints against decoding one value per call, for value distributions
+// of different encoded lengths. DecodeVarint itself needs the exact length of the value (it
+// rejects a 10-byte buffer ending in a byte above 1, even one of the next value), so the
+// per-value baseline is DecodeVarints over a single-element span.
+// Build from the repository root:
+//   g++ -std=c++20 -O2 -I. benchmarks/varint_benchmark.cpp varint.cpp bitops.cpp -o varint_benchmark
+
+#include "benchmarks/benchmark.h"
+#include "bitops.h"
+#include "varint.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr size_t VALUES = size_t{1} << 20;
+
+    void Run(const char *name, const std::function<uint64_t(std::mt19937_64 &)> &generate) {
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> values(VALUES);
+        std::vector<uint8_t> encoded;
+        for (uint64_t &value : values) {
+            value = generate(random);
+            uint8_t buffer[MAX_VARINT_SIZE];
+            size_t length = EncodeVarint(value, buffer);
+            encoded.insert(encoded.end(), buffer, buffer + length);
+        }
+        std::vector<uint64_t> decoded(VALUES);
+
+        double single = MeasureBillionsPerSecond(VALUES, [&] {
+            size_t offset = 0;
+            for (uint64_t &value : decoded) {
+                offset += DecodeVarints(encoded.data() + offset, encoded.size() - offset, std::span<uint64_t>(&value, 1));
+            }
+            sink = offset;
+        });
+        bool single_ok = decoded == values;
+        decoded.assign(VALUES, 0);
+        double batch = MeasureBillionsPerSecond(VALUES, [&] { sink = DecodeVarints(encoded.data(), encoded.size(), decoded); });
+        bool batch_ok = decoded == values;
+        std::printf("%-20s %5.2f bytes/value   one per call %5.2f G/s   DecodeVarints %5.2f G/s%s\n", name,
+                    static_cast<double>(encoded.size()) / VALUES, single, batch,
+                    single_ok && batch_ok ? "" : "   MISMATCH");
+    }
+}
+
+int main() {
+    const CpuFeatures &features = GetCpuFeatures();
+    std::printf("avx2=%d bmi2=%d\n", features.avx2, features.bmi2);
+    Run("1 byte (< 2^7)", [](std::mt19937_64 &random) { return random() % 128; });
+    Run("1-2 bytes (< 2^14)", [](std::mt19937_64 &random) { return random() >> (50 + random() % 14); });
+    Run("1-4 bytes (< 2^28)", [](std::mt19937_64 &random) { return random() >> (36 + random() % 28); });
+    Run("3-4 bytes", [](std::mt19937_64 &random) { return (uint64_t{1} << 14) + random() % ((uint64_t{1} << 28) - (1 << 14)); });
+    Run("1-10 bytes (any)", [](std::mt19937_64 &random) { return random() >> (random() % 64); });
+    return 0;
+}
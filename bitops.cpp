@@ -1,180 +1,215 @@
 #include "bitops.h"
+#include <algorithm>
+#include <array>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BITOPS_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace {
-    constexpr size_t BITS_IN_BYTE = 8;
-    constexpr size_t BITS_IN_UINT64 = BITS_IN_BYTE * 8;
-    constexpr uint64_t FIRST_BIT_IN_UINT64_MASK = 0x8000000000000000;
-    constexpr uint64_t FIRST_BYTE_IN_UINT64_MASK = 0xff00000000000000;
-}
+    CpuFeatures DetectCpuFeatures() {
+        CpuFeatures features;
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        features.popcnt = __builtin_cpu_supports("popcnt");
+        features.bmi2 = __builtin_cpu_supports("bmi2");
+        features.avx2 = __builtin_cpu_supports("avx2");
+        features.fma = __builtin_cpu_supports("fma");
+        features.f16c = __builtin_cpu_supports("f16c");
+        features.avx512f = __builtin_cpu_supports("avx512f");
+        features.avx512bw = __builtin_cpu_supports("avx512bw");
+        features.avx512vpopcntdq = __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+        return features;
+    }
 
-uint64_t SwapBytes(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = FIRST_BYTE_IN_UINT64_MASK;
-    size_t shift = 2 * BITS_IN_UINT64 - BITS_IN_BYTE;
-    for (size_t i = 0; i < BITS_IN_UINT64 / BITS_IN_BYTE; ++i) {
-        std::cout << shift << " ";
-        if (shift > BITS_IN_UINT64) {
-            result |= (value & mask) >> (shift - BITS_IN_UINT64);
-        } else {
-            result |= (value & mask) << (BITS_IN_UINT64 - shift);
+    uint64_t PopcountScalar(const uint64_t *values, size_t size) {
+        uint64_t result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result += CountSetBits(values[i]);
         }
-        mask >>= BITS_IN_BYTE;
-        shift -= 2 * BITS_IN_BYTE;
+        return result;
     }
-    return result;
-}
 
-uint64_t ReverseBits(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (i < BITS_IN_UINT64 / 2) {
-            result |= (value & mask) << ((BITS_IN_UINT64 - 1) - i * 2);
-        } else {
-            result |= (value & mask) >> (i * 2 - (BITS_IN_UINT64 - 1));
+    void SwapBytesScalar(const uint64_t *values, uint64_t *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = SwapBytes(values[i]);
         }
-        mask <<= 1;
     }
-    return result;
-}
 
-uint64_t ReverseBitsInBytes(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (i % BITS_IN_BYTE < BITS_IN_BYTE / 2) {
-            result |= (value & mask) << ((BITS_IN_BYTE - 1) - (i % BITS_IN_BYTE) * 2);
-        } else {
-            result |= (value & mask) >> ((i % BITS_IN_BYTE) * 2 - (BITS_IN_BYTE - 1));
+    void ReverseBitsInBytesScalar(const uint64_t *values, uint64_t *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = ReverseBitsInBytes(values[i]);
         }
-        mask <<= 1;
     }
-    return result;
-}
 
-uint64_t SetBits(uint64_t value, uint64_t offset, uint64_t count, uint64_t bits) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (i >= offset && i < offset + count) {
-            result |= (bits & (mask >> offset)) << offset;
-        } else {
-            result |= value & mask;
+#if defined(BITOPS_X86_SIMD)
+    // pshufb tables work within 128-bit lanes, so every table is repeated for each lane of a zmm register
+    using ShuffleTable = std::array<char, 64>;
+
+    constexpr ShuffleTable RepeatForEachLane(const char (&table)[16]) {
+        ShuffleTable result = {};
+        for (size_t i = 0; i < result.size(); ++i) {
+            result[i] = table[i % 16];
         }
-        mask <<= 1;
+        return result;
     }
-    return result;
-}
 
-uint64_t ExtractBits(uint64_t value, uint64_t offset, uint64_t count) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (i >= offset && i < offset + count) {
-            result |= (value & mask) >> offset;
+    // Bytes of every 64-bit element in reverse order
+    constexpr char BSWAP64_SHUFFLE[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+    // Number of set bits and bit-reversed value of every nibble
+    constexpr char NIBBLE_POPCOUNT[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    constexpr char NIBBLE_REVERSE[16] = {0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+                                         0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf};
+
+    constexpr ShuffleTable BSWAP64_TABLE = RepeatForEachLane(BSWAP64_SHUFFLE);
+    constexpr ShuffleTable NIBBLE_POPCOUNT_TABLE = RepeatForEachLane(NIBBLE_POPCOUNT);
+    constexpr ShuffleTable NIBBLE_REVERSE_TABLE = RepeatForEachLane(NIBBLE_REVERSE);
+
+    __attribute__((target("avx2")))
+    __m256i LoadTable256(const ShuffleTable &table) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(table.data()));
+    }
+
+    __attribute__((target("avx512f")))
+    __m512i LoadTable512(const ShuffleTable &table) {
+        return _mm512_loadu_si512(table.data());
+    }
+
+    __attribute__((target("avx2")))
+    uint64_t PopcountAvx2(const uint64_t *values, size_t size) {
+        const __m256i table = LoadTable256(NIBBLE_POPCOUNT_TABLE);
+        const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+        __m256i total = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+            __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low_nibbles));
+            __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles));
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
         }
-        mask <<= 1;
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), total);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + PopcountScalar(values + i, size - i);
     }
-    return result;
-}
 
-uint32_t CountSetBits(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (value & mask) {
-            ++result;
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    uint64_t PopcountAvx512(const uint64_t *values, size_t size) {
+        __m512i total = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(values + i)));
         }
-        mask <<= 1;
+        uint64_t lanes[8];
+        _mm512_storeu_si512(lanes, total);
+        uint64_t result = PopcountScalar(values + i, size - i);
+        for (uint64_t lane : lanes) {
+            result += lane;
+        }
+        return result;
     }
-    return result;
-}
 
-uint32_t CountTrailingZeros(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = 1;
-    bool flag = true;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (!flag) {
-            break;
+    __attribute__((target("avx2")))
+    void SwapBytesAvx2(const uint64_t *values, uint64_t *result, size_t size) {
+        const __m256i shuffle = LoadTable256(BSWAP64_TABLE);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), _mm256_shuffle_epi8(v, shuffle));
         }
-        if (value & mask) {
-            flag = false;
-        } else {
-            ++result;
+        SwapBytesScalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void SwapBytesAvx512(const uint64_t *values, uint64_t *result, size_t size) {
+        const __m512i shuffle = LoadTable512(BSWAP64_TABLE);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            _mm512_storeu_si512(result + i, _mm512_shuffle_epi8(_mm512_loadu_si512(values + i), shuffle));
         }
-        mask <<= 1;
+        SwapBytesScalar(values + i, result + i, size - i);
     }
-    return result;
-}
 
-uint32_t CountLeadingZeros(uint64_t value) {
-    uint64_t result = 0;
-    uint64_t mask = FIRST_BIT_IN_UINT64_MASK;
-    bool flag = true;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (!flag) {
-            break;
+    __attribute__((target("avx2")))
+    void ReverseBitsInBytesAvx2(const uint64_t *values, uint64_t *result, size_t size) {
+        const __m256i table = LoadTable256(NIBBLE_REVERSE_TABLE);
+        const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+            __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low_nibbles));
+            __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles));
+            __m256i reversed = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(lo, 4), _mm256_set1_epi8(-16)), hi);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), reversed);
         }
-        if (value & mask) {
-            flag = false;
-        } else {
-            ++result;
+        ReverseBitsInBytesScalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void ReverseBitsInBytesAvx512(const uint64_t *values, uint64_t *result, size_t size) {
+        const __m512i table = LoadTable512(NIBBLE_REVERSE_TABLE);
+        const __m512i low_nibbles = _mm512_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m512i v = _mm512_loadu_si512(values + i);
+            __m512i lo = _mm512_shuffle_epi8(table, _mm512_and_si512(v, low_nibbles));
+            __m512i hi = _mm512_shuffle_epi8(table, _mm512_and_si512(_mm512_srli_epi16(v, 4), low_nibbles));
+            __m512i reversed = _mm512_or_si512(_mm512_and_si512(_mm512_slli_epi16(lo, 4), _mm512_set1_epi8(-16)), hi);
+            _mm512_storeu_si512(result + i, reversed);
         }
-        mask >>= 1;
+        ReverseBitsInBytesScalar(values + i, result + i, size - i);
     }
-    return result;
+#endif
 }
 
-uint64_t RotateLeft(uint64_t value, uint32_t shift) {
-    uint64_t result = 0;
-    result |= value << (shift % BITS_IN_UINT64);
-    result |= value >> (BITS_IN_UINT64 - (shift % BITS_IN_UINT64));
-    return result;
+const CpuFeatures &GetCpuFeatures() {
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
 }
 
-uint64_t RotateRight(uint64_t value, uint32_t shift) {
-    uint64_t result = 0;
-    result |= value >> (shift % BITS_IN_UINT64);
-    result |= value << (BITS_IN_UINT64 - (shift % BITS_IN_UINT64));
-    return result;
+uint64_t PopcountSpan(std::span<const uint64_t> values) {
+#if defined(BITOPS_X86_SIMD)
+    if (GetCpuFeatures().avx512vpopcntdq) {
+        return PopcountAvx512(values.data(), values.size());
+    }
+    if (GetCpuFeatures().avx2) {
+        return PopcountAvx2(values.data(), values.size());
+    }
+#endif
+    return PopcountScalar(values.data(), values.size());
 }
 
-bool IsPowerOfTwo(uint64_t value) {
-    uint64_t mask = 1;
-    bool flag = false;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (value & mask) {
-            if (flag) {
-                return false;
-            } else {
-                flag = true;
-            }            
-        }
-        mask <<= 1;
-    }
-    return flag;
+void SwapBytesSpan(std::span<uint64_t> values) {
+    SwapBytesSpan(values, values);
 }
 
-uint64_t RoundUpToPowerOfTwo(uint64_t value) {
-    if (!(~value)) {
-        return 0;
+void SwapBytesSpan(std::span<const uint64_t> values, std::span<uint64_t> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(BITOPS_X86_SIMD)
+    if (GetCpuFeatures().avx512bw) {
+        return SwapBytesAvx512(values.data(), result.data(), size);
     }
-    uint64_t mask = FIRST_BIT_IN_UINT64_MASK;
-    uint64_t result = 1;
-    for (size_t i = 0; i < BITS_IN_UINT64; ++i) {
-        if (value & mask) {
-            return result << ((value & ~mask) ? BITS_IN_UINT64 - i : (BITS_IN_UINT64 - 1) - i);
-        }
-        mask >>= 1;
+    if (GetCpuFeatures().avx2) {
+        return SwapBytesAvx2(values.data(), result.data(), size);
     }
-    return 1;
+#endif
+    SwapBytesScalar(values.data(), result.data(), size);
 }
 
-uint64_t AlignDown(uint64_t value, uint64_t alignment) {
-    return value & ~(alignment - 1);
+void ReverseBitsInBytesSpan(std::span<uint64_t> values) {
+    ReverseBitsInBytesSpan(values, values);
 }
 
-uint64_t AlignUp(uint64_t value, uint64_t alignment) {
-    return (value + alignment - 1) & ~(alignment - 1);
+void ReverseBitsInBytesSpan(std::span<const uint64_t> values, std::span<uint64_t> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(BITOPS_X86_SIMD)
+    if (GetCpuFeatures().avx512bw) {
+        return ReverseBitsInBytesAvx512(values.data(), result.data(), size);
+    }
+    if (GetCpuFeatures().avx2) {
+        return ReverseBitsInBytesAvx2(values.data(), result.data(), size);
+    }
+#endif
+    ReverseBitsInBytesScalar(values.data(), result.data(), size);
 }
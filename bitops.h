@@ -0,0 +1,162 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace bitops_detail {
+    constexpr uint64_t BITS_IN_BYTE = 8;
+    constexpr uint64_t BITS_IN_UINT64 = BITS_IN_BYTE * 8;
+    constexpr uint64_t HIGHEST_BIT_IN_UINT64 = 0x8000000000000000;
+
+    // Bits [offset, offset + count) clipped to the word; empty if the range starts past
+    // the word or offset + count wraps around
+    constexpr uint64_t RangeMask(uint64_t offset, uint64_t count) {
+        uint64_t end = offset + count;
+        if (offset >= BITS_IN_UINT64 || end <= offset) {
+            return 0;
+        }
+        uint64_t width = (end < BITS_IN_UINT64 ? end : BITS_IN_UINT64) - offset;
+        uint64_t low_bits = width == BITS_IN_UINT64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+        return low_bits << offset;
+    }
+}
+
+// Per-CPU instruction set extensions, detected once on first use. The single-word functions
+// below are resolved at compile time (-mpopcnt, -mbmi2, -march=...), since a dispatch per call
+// would cost more than the instruction itself; the array kernels switch on these flags.
+struct CpuFeatures {
+    bool popcnt = false;
+    bool bmi2 = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vpopcntdq = false;
+};
+
+const CpuFeatures &GetCpuFeatures();
+
+constexpr uint64_t SwapBytes(uint64_t value) {
+#if defined(__cpp_lib_byteswap)
+    return std::byteswap(value);
+#else
+    return __builtin_bswap64(value);
+#endif
+}
+
+constexpr uint64_t ReverseBitsInBytes(uint64_t value) {
+    value = ((value >> 1) & 0x5555555555555555) | ((value & 0x5555555555555555) << 1);
+    value = ((value >> 2) & 0x3333333333333333) | ((value & 0x3333333333333333) << 2);
+    value = ((value >> 4) & 0x0f0f0f0f0f0f0f0f) | ((value & 0x0f0f0f0f0f0f0f0f) << 4);
+    return value;
+}
+
+constexpr uint64_t ReverseBits(uint64_t value) {
+    return SwapBytes(ReverseBitsInBytes(value));
+}
+
+constexpr uint64_t SetBits(uint64_t value, uint64_t offset, uint64_t count, uint64_t bits) {
+    uint64_t mask = bitops_detail::RangeMask(offset, count);
+    if (mask == 0) {
+        return value;
+    }
+    return (value & ~mask) | ((bits << offset) & mask);
+}
+
+constexpr uint64_t ExtractBits(uint64_t value, uint64_t offset, uint64_t count) {
+#if defined(__BMI2__)
+    if (!std::is_constant_evaluated()) {
+        uint64_t end = offset + count;
+        if (offset >= bitops_detail::BITS_IN_UINT64 || end <= offset) {
+            return 0;
+        }
+        // bzhi keeps the whole word for an index of 64
+        uint64_t width = count < bitops_detail::BITS_IN_UINT64 ? count : bitops_detail::BITS_IN_UINT64;
+        return _bzhi_u64(value >> offset, static_cast<unsigned>(width));
+    }
+#endif
+    uint64_t mask = bitops_detail::RangeMask(offset, count);
+    return mask == 0 ? 0 : (value & mask) >> offset;
+}
+
+constexpr uint32_t CountSetBits(uint64_t value) {
+    return static_cast<uint32_t>(std::popcount(value));
+}
+
+constexpr uint32_t CountTrailingZeros(uint64_t value) {
+    return static_cast<uint32_t>(std::countr_zero(value));
+}
+
+constexpr uint32_t CountLeadingZeros(uint64_t value) {
+    return static_cast<uint32_t>(std::countl_zero(value));
+}
+
+constexpr uint64_t RotateLeft(uint64_t value, uint32_t shift) {
+    return std::rotl(value, static_cast<int>(shift % bitops_detail::BITS_IN_UINT64));
+}
+
+constexpr uint64_t RotateRight(uint64_t value, uint32_t shift) {
+    return std::rotr(value, static_cast<int>(shift % bitops_detail::BITS_IN_UINT64));
+}
+
+// Position of the set bit with the given zero-based rank, 64 if there are not that many
+constexpr uint32_t SelectBitInWord(uint64_t value, uint32_t rank) {
+#if defined(__BMI2__)
+    if (!std::is_constant_evaluated()) {
+        return rank < bitops_detail::BITS_IN_UINT64 ? CountTrailingZeros(_pdep_u64(uint64_t{1} << rank, value))
+                                                     : static_cast<uint32_t>(bitops_detail::BITS_IN_UINT64);
+    }
+#endif
+    // Byte-wise prefix popcounts: byte i of `prefix` is the number of set bits in bytes 0..i
+    uint64_t counts = value - ((value >> 1) & 0x5555555555555555);
+    counts = (counts & 0x3333333333333333) + ((counts >> 2) & 0x3333333333333333);
+    counts = (counts + (counts >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    uint64_t prefix = counts * 0x0101010101010101;
+    for (uint32_t byte = 0; byte < bitops_detail::BITS_IN_BYTE; ++byte) {
+        uint32_t through_byte = (prefix >> (byte * bitops_detail::BITS_IN_BYTE)) & 0xff;
+        if (rank < through_byte) {
+            uint32_t before_byte = byte == 0 ? 0 : (prefix >> ((byte - 1) * bitops_detail::BITS_IN_BYTE)) & 0xff;
+            uint64_t bits = (value >> (byte * bitops_detail::BITS_IN_BYTE)) & 0xff;
+            for (uint32_t skip = rank - before_byte; skip > 0; --skip) {
+                bits &= bits - 1;
+            }
+            return byte * bitops_detail::BITS_IN_BYTE + CountTrailingZeros(bits);
+        }
+    }
+    return static_cast<uint32_t>(bitops_detail::BITS_IN_UINT64);
+}
+
+constexpr bool IsPowerOfTwo(uint64_t value) {
+    return std::has_single_bit(value);
+}
+
+// Returns 0 when the result does not fit into 64 bits
+constexpr uint64_t RoundUpToPowerOfTwo(uint64_t value) {
+    if (value > bitops_detail::HIGHEST_BIT_IN_UINT64) {
+        return 0;
+    }
+    return std::bit_ceil(value);
+}
+
+constexpr uint64_t AlignDown(uint64_t value, uint64_t alignment) {
+    return value & ~(alignment - 1);
+}
+
+constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Array versions of the functions above, vectorized with AVX2 / AVX-512 when the CPU has it.
+// The out-of-place overloads process min(values.size(), result.size()) elements.
+uint64_t PopcountSpan(std::span<const uint64_t> values);
+void SwapBytesSpan(std::span<uint64_t> values);
+void SwapBytesSpan(std::span<const uint64_t> values, std::span<uint64_t> result);
+void ReverseBitsInBytesSpan(std::span<uint64_t> values);
+void ReverseBitsInBytesSpan(std::span<const uint64_t> values, std::span<uint64_t> result);
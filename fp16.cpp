@@ -1,32 +1,261 @@
 #include "fp16.h"
-#include <cmath>
+#include "bitops.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FP16_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace {
-    constexpr size_t SIGN_BIT_MASK = 0x8000;
-    constexpr size_t SIGN_BIT_SHIFT = 15;
-    constexpr size_t EXP_BITS_MASK = 0x7c00;
-    constexpr size_t EXP_BITS_SHIFT = 10;
-    constexpr size_t MAN_BITS_MASK = 0x3ff;
-    constexpr size_t EXP_MIN = -14;
-    constexpr size_t EXP_MAX = 31;
-    constexpr size_t EXP_BIAS = 15;
-    constexpr double MAN_DENOM = 1024.0;
-}
+    constexpr uint32_t SIGN_BIT_MASK = 0x8000;
+    constexpr uint32_t SIGN_BIT_SHIFT = 16;  // From binary16 to binary32 position
+    constexpr uint32_t EXP_BITS_MASK = 0x7c00;
+    constexpr uint32_t EXP_BITS_SHIFT = 10;
+    constexpr uint32_t MAN_BITS_MASK = 0x3ff;
+    constexpr uint32_t EXP_MAX = 31;
+    constexpr uint32_t EXP_BIAS = 15;
 
-float ConvertFloat16ToFloat(uint16_t float16_bits) {
-    size_t sign = (float16_bits & SIGN_BIT_MASK) >> SIGN_BIT_SHIFT;
-    size_t exp = (float16_bits & EXP_BITS_MASK) >> EXP_BITS_SHIFT;
-    size_t man = float16_bits & MAN_BITS_MASK;
-
-    if (exp == 0) {
-        return std::powf(-1, sign) * std::powf(2, EXP_MIN) * man / MAN_DENOM;
-    } else if (exp == EXP_MAX) {
-        if (man == 0) {
-            return std::powf(-1, sign) * std::numeric_limits<float>::infinity();
+    constexpr uint32_t FLOAT_MAN_BITS = 23;
+    constexpr uint32_t FLOAT_EXP_BIAS = 127;
+    constexpr uint32_t FLOAT_EXP_BITS = 0x7f800000;
+    constexpr uint32_t FLOAT_QUIET_BIT = 0x400000;
+    constexpr uint32_t MAN_SHIFT = FLOAT_MAN_BITS - EXP_BITS_SHIFT;
+    // A subnormal binary16 is man * 2^-24
+    constexpr uint32_t SUBNORMAL_EXP = EXP_BIAS + EXP_BITS_SHIFT - 1;
+    constexpr uint32_t FLOAT_MAN_MASK = (1u << FLOAT_MAN_BITS) - 1;
+    constexpr uint32_t FLOAT_EXP_MAX = 0xff;
+    constexpr uint32_t FLOAT16_QUIET_BIT = 0x200;
+    constexpr uint32_t BFLOAT16_SHIFT = 16;
+    constexpr uint32_t BFLOAT16_QUIET_BIT = 0x40;
+
+    uint32_t ConvertFloat16ToFloatBits(uint16_t float16_bits) {
+        uint32_t sign = (float16_bits & SIGN_BIT_MASK) << SIGN_BIT_SHIFT;
+        uint32_t exp = (float16_bits & EXP_BITS_MASK) >> EXP_BITS_SHIFT;
+        uint32_t man = float16_bits & MAN_BITS_MASK;
+
+        if (exp == 0) {
+            if (man == 0) {
+                return sign;
+            }
+            // Renormalize: the highest set bit of the mantissa becomes the implicit one
+            uint32_t top_bit = 63 - CountLeadingZeros(man);
+            uint32_t float_exp = top_bit + FLOAT_EXP_BIAS - SUBNORMAL_EXP;
+            uint32_t float_man = (man << (FLOAT_MAN_BITS - top_bit)) & ((1u << FLOAT_MAN_BITS) - 1);
+            return sign | (float_exp << FLOAT_MAN_BITS) | float_man;
+        } else if (exp == EXP_MAX) {
+            return sign | FLOAT_EXP_BITS | (man == 0 ? 0 : FLOAT_QUIET_BIT | (man << MAN_SHIFT));
         } else {
-            return std::nanf(" ");
+            return sign | ((exp + FLOAT_EXP_BIAS - EXP_BIAS) << FLOAT_MAN_BITS) | (man << MAN_SHIFT);
+        }
+    }
+
+    // Drops the low `shift` bits of the value, rounding to nearest even
+    uint32_t ShiftRightRoundEven(uint32_t value, uint32_t shift) {
+        uint32_t result = value >> shift;
+        uint32_t remainder = value & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1))) {
+            ++result;
+        }
+        return result;
+    }
+
+    uint16_t ConvertFloatBitsToFloat16(uint32_t float_bits) {
+        uint32_t sign = (float_bits >> SIGN_BIT_SHIFT) & SIGN_BIT_MASK;
+        uint32_t float_exp = (float_bits >> FLOAT_MAN_BITS) & FLOAT_EXP_MAX;
+        uint32_t float_man = float_bits & FLOAT_MAN_MASK;
+
+        if (float_exp == FLOAT_EXP_MAX) {
+            uint32_t nan = float_man == 0 ? 0 : FLOAT16_QUIET_BIT | (float_man >> MAN_SHIFT);
+            return static_cast<uint16_t>(sign | EXP_BITS_MASK | nan);
+        }
+        int32_t exp = static_cast<int32_t>(float_exp) - static_cast<int32_t>(FLOAT_EXP_BIAS - EXP_BIAS);
+        if (exp >= static_cast<int32_t>(EXP_MAX)) {
+            return static_cast<uint16_t>(sign | EXP_BITS_MASK);
+        }
+        if (exp <= 0) {
+            // Subnormal result; anything below half of the smallest subnormal rounds to zero
+            if (exp < -static_cast<int32_t>(EXP_BITS_SHIFT)) {
+                return static_cast<uint16_t>(sign);
+            }
+            uint32_t man = float_man | (1u << FLOAT_MAN_BITS);
+            return static_cast<uint16_t>(sign | ShiftRightRoundEven(man, MAN_SHIFT + 1 - exp));
+        }
+        // A carry out of the mantissa correctly bumps the exponent, up to infinity
+        uint32_t bits = (static_cast<uint32_t>(exp) << FLOAT_MAN_BITS) | float_man;
+        return static_cast<uint16_t>(sign | ShiftRightRoundEven(bits, MAN_SHIFT));
+    }
+
+    uint16_t ConvertFloatBitsToBFloat16(uint32_t float_bits) {
+        if ((float_bits & ~(SIGN_BIT_MASK << SIGN_BIT_SHIFT)) > FLOAT_EXP_BITS) {
+            return static_cast<uint16_t>((float_bits >> BFLOAT16_SHIFT) | BFLOAT16_QUIET_BIT);
+        }
+        return static_cast<uint16_t>(ShiftRightRoundEven(float_bits, BFLOAT16_SHIFT));
+    }
+
+    void ConvertFloat16ToFloatScalar(const uint16_t *values, float *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = std::bit_cast<float>(ConvertFloat16ToFloatBits(values[i]));
+        }
+    }
+
+    void ConvertFloatToFloat16Scalar(const float *values, uint16_t *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = ConvertFloatBitsToFloat16(std::bit_cast<uint32_t>(values[i]));
+        }
+    }
+
+    void ConvertFloatToBFloat16Scalar(const float *values, uint16_t *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = ConvertFloatBitsToBFloat16(std::bit_cast<uint32_t>(values[i]));
+        }
+    }
+
+    void ConvertBFloat16ToFloatScalar(const uint16_t *values, float *result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = std::bit_cast<float>(static_cast<uint32_t>(values[i]) << BFLOAT16_SHIFT);
+        }
+    }
+
+#if defined(FP16_X86_SIMD)
+    __attribute__((target("avx,f16c")))
+    void ConvertFloat16ToFloatF16c(const uint16_t *values, float *result, size_t size) {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+            _mm256_storeu_ps(result + i, _mm256_cvtph_ps(half));
+        }
+        ConvertFloat16ToFloatScalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx512f")))
+    void ConvertFloat16ToFloatAvx512(const uint16_t *values, float *result, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m256i half = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+            _mm512_storeu_ps(result + i, _mm512_maskz_cvtph_ps(0xffff, half));
         }
-    } else {
-        return std::powf(-1, sign) * std::powf(2, exp - EXP_BIAS) * (1 + man / MAN_DENOM);
+        ConvertFloat16ToFloatScalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx,f16c")))
+    void ConvertFloatToFloat16F16c(const float *values, uint16_t *result, size_t size) {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(result + i), half);
+        }
+        ConvertFloatToFloat16Scalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx512f")))
+    void ConvertFloatToFloat16Avx512(const float *values, uint16_t *result, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m256i half = _mm512_maskz_cvtps_ph(0xffff, _mm512_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), half);
+        }
+        ConvertFloatToFloat16Scalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx2")))
+    void ConvertFloatToBFloat16Avx2(const float *values, uint16_t *result, size_t size) {
+        const __m256i abs_mask = _mm256_set1_epi32(0x7fffffff);
+        const __m256i infinity = _mm256_set1_epi32(FLOAT_EXP_BITS);
+        const __m256i quiet_bit = _mm256_set1_epi32(BFLOAT16_QUIET_BIT << BFLOAT16_SHIFT);
+        const __m256i rounding_bias = _mm256_set1_epi32(0x7fff);
+        const __m256i one = _mm256_set1_epi32(1);
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m256i halves[2];
+            for (size_t j = 0; j < 2; ++j) {
+                __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 8 * j));
+                __m256i lowest_kept = _mm256_and_si256(_mm256_srli_epi32(bits, BFLOAT16_SHIFT), one);
+                __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(rounding_bias, lowest_kept));
+                __m256i is_nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, abs_mask), infinity);
+                __m256i nan = _mm256_or_si256(bits, quiet_bit);
+                halves[j] = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, nan, is_nan), BFLOAT16_SHIFT);
+            }
+            // packus works within 128-bit lanes, the permute restores the element order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(halves[0], halves[1]), 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), packed);
+        }
+        ConvertFloatToBFloat16Scalar(values + i, result + i, size - i);
+    }
+
+    __attribute__((target("avx2")))
+    void ConvertBFloat16ToFloatAvx2(const uint16_t *values, float *result, size_t size) {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m128i bfloat = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+            __m256i bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(bfloat), BFLOAT16_SHIFT);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), bits);
+        }
+        ConvertBFloat16ToFloatScalar(values + i, result + i, size - i);
+    }
+#endif
+}
+
+float ConvertFloat16ToFloat(uint16_t float16_bits) {
+    return std::bit_cast<float>(ConvertFloat16ToFloatBits(float16_bits));
+}
+
+void ConvertFloat16ToFloatSpan(std::span<const uint16_t> values, std::span<float> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(FP16_X86_SIMD)
+    if (GetCpuFeatures().avx512f) {
+        return ConvertFloat16ToFloatAvx512(values.data(), result.data(), size);
+    }
+    if (GetCpuFeatures().f16c) {
+        return ConvertFloat16ToFloatF16c(values.data(), result.data(), size);
+    }
+#endif
+    ConvertFloat16ToFloatScalar(values.data(), result.data(), size);
+}
+
+uint16_t ConvertFloatToFloat16(float value) {
+    return ConvertFloatBitsToFloat16(std::bit_cast<uint32_t>(value));
+}
+
+void ConvertFloatToFloat16Span(std::span<const float> values, std::span<uint16_t> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(FP16_X86_SIMD)
+    if (GetCpuFeatures().avx512f) {
+        return ConvertFloatToFloat16Avx512(values.data(), result.data(), size);
+    }
+    if (GetCpuFeatures().f16c) {
+        return ConvertFloatToFloat16F16c(values.data(), result.data(), size);
+    }
+#endif
+    ConvertFloatToFloat16Scalar(values.data(), result.data(), size);
+}
+
+uint16_t ConvertFloatToBFloat16(float value) {
+    return ConvertFloatBitsToBFloat16(std::bit_cast<uint32_t>(value));
+}
+
+float ConvertBFloat16ToFloat(uint16_t bfloat16_bits) {
+    return std::bit_cast<float>(static_cast<uint32_t>(bfloat16_bits) << BFLOAT16_SHIFT);
+}
+
+void ConvertFloatToBFloat16Span(std::span<const float> values, std::span<uint16_t> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(FP16_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return ConvertFloatToBFloat16Avx2(values.data(), result.data(), size);
+    }
+#endif
+    ConvertFloatToBFloat16Scalar(values.data(), result.data(), size);
+}
+
+void ConvertBFloat16ToFloatSpan(std::span<const uint16_t> values, std::span<float> result) {
+    size_t size = std::min(values.size(), result.size());
+#if defined(FP16_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return ConvertBFloat16ToFloatAvx2(values.data(), result.data(), size);
     }
+#endif
+    ConvertBFloat16ToFloatScalar(values.data(), result.data(), size);
 }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// IEEE 754 binary16 to binary32; exact for every input, NaN payloads are kept and made quiet
+float ConvertFloat16ToFloat(uint16_t float16_bits);
+
+// Converts min(values.size(), result.size()) elements with F16C / AVX-512 when available,
+// bit-identical to ConvertFloat16ToFloat
+void ConvertFloat16ToFloatSpan(std::span<const uint16_t> values, std::span<float> result);
+
+// IEEE 754 binary32 to binary16 with round-to-nearest-even: overflow gives infinity, tiny values
+// become subnormals or zero, NaNs keep their sign and top payload bits and are made quiet
+uint16_t ConvertFloatToFloat16(float value);
+void ConvertFloatToFloat16Span(std::span<const float> values, std::span<uint16_t> result);
+
+// bfloat16: the upper half of a binary32, rounded to nearest even
+uint16_t ConvertFloatToBFloat16(float value);
+float ConvertBFloat16ToFloat(uint16_t bfloat16_bits);
+void ConvertFloatToBFloat16Span(std::span<const float> values, std::span<uint16_t> result);
+void ConvertBFloat16ToFloatSpan(std::span<const uint16_t> values, std::span<float> result);
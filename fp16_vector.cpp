@@ -0,0 +1,161 @@
+#include "fp16_vector.h"
+#include "bitops.h"
+#include "fp16.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FP16_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Rows are scored this many at a time during the top-k scan
+    constexpr size_t TOP_K_BATCH = 256;
+
+    float DotScalar(const uint16_t *a, const uint16_t *b, size_t size) {
+        float result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result += ConvertFloat16ToFloat(a[i]) * ConvertFloat16ToFloat(b[i]);
+        }
+        return result;
+    }
+
+    float L2SqrScalar(const uint16_t *a, const uint16_t *b, size_t size) {
+        float result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            float diff = ConvertFloat16ToFloat(a[i]) - ConvertFloat16ToFloat(b[i]);
+            result += diff * diff;
+        }
+        return result;
+    }
+
+    using Kernel = float (*)(const uint16_t *, const uint16_t *, size_t);
+
+#if defined(FP16_X86_SIMD)
+    __attribute__((target("avx,f16c")))
+    __m256 Load8(const uint16_t *values) {
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values)));
+    }
+
+    __attribute__((target("avx")))
+    float HorizontalSum(__m256 values) {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        return _mm_cvtss_f32(sum);
+    }
+
+    __attribute__((target("avx,f16c,fma")))
+    float DotF16c(const uint16_t *a, const uint16_t *b, size_t size) {
+        __m256 first = _mm256_setzero_ps();
+        __m256 second = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            first = _mm256_fmadd_ps(Load8(a + i), Load8(b + i), first);
+            second = _mm256_fmadd_ps(Load8(a + i + 8), Load8(b + i + 8), second);
+        }
+        if (i + 8 <= size) {
+            first = _mm256_fmadd_ps(Load8(a + i), Load8(b + i), first);
+            i += 8;
+        }
+        return HorizontalSum(_mm256_add_ps(first, second)) + DotScalar(a + i, b + i, size - i);
+    }
+
+    __attribute__((target("avx,f16c,fma")))
+    float L2SqrF16c(const uint16_t *a, const uint16_t *b, size_t size) {
+        __m256 first = _mm256_setzero_ps();
+        __m256 second = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m256 diff_first = _mm256_sub_ps(Load8(a + i), Load8(b + i));
+            __m256 diff_second = _mm256_sub_ps(Load8(a + i + 8), Load8(b + i + 8));
+            first = _mm256_fmadd_ps(diff_first, diff_first, first);
+            second = _mm256_fmadd_ps(diff_second, diff_second, second);
+        }
+        if (i + 8 <= size) {
+            __m256 diff = _mm256_sub_ps(Load8(a + i), Load8(b + i));
+            first = _mm256_fmadd_ps(diff, diff, first);
+            i += 8;
+        }
+        return HorizontalSum(_mm256_add_ps(first, second)) + L2SqrScalar(a + i, b + i, size - i);
+    }
+
+    bool HasF16cFma() {
+        return GetCpuFeatures().avx2 && GetCpuFeatures().f16c && GetCpuFeatures().fma;
+    }
+#endif
+
+    Kernel SelectKernel(F16Metric metric) {
+#if defined(FP16_X86_SIMD)
+        if (HasF16cFma()) {
+            return metric == F16Metric::Dot ? DotF16c : L2SqrF16c;
+        }
+#endif
+        return metric == F16Metric::Dot ? DotScalar : L2SqrScalar;
+    }
+
+    void ScoreRows(Kernel kernel, std::span<const uint16_t> query, std::span<const uint16_t> matrix,
+                   size_t first_row, std::span<float> scores) {
+        size_t dim = query.size();
+        for (size_t i = 0; i < scores.size(); ++i) {
+            scores[i] = kernel(query.data(), matrix.data() + (first_row + i) * dim, dim);
+        }
+    }
+
+    size_t RowCount(std::span<const uint16_t> query, std::span<const uint16_t> matrix) {
+        return query.empty() ? 0 : matrix.size() / query.size();
+    }
+}
+
+float DotF16(std::span<const uint16_t> a, std::span<const uint16_t> b) {
+    return SelectKernel(F16Metric::Dot)(a.data(), b.data(), std::min(a.size(), b.size()));
+}
+
+float L2SqrF16(std::span<const uint16_t> a, std::span<const uint16_t> b) {
+    return SelectKernel(F16Metric::L2Sqr)(a.data(), b.data(), std::min(a.size(), b.size()));
+}
+
+void DotF16Batch(std::span<const uint16_t> query, std::span<const uint16_t> matrix, std::span<float> scores) {
+    size_t rows = std::min(scores.size(), RowCount(query, matrix));
+    ScoreRows(SelectKernel(F16Metric::Dot), query, matrix, 0, scores.first(rows));
+}
+
+void L2SqrF16Batch(std::span<const uint16_t> query, std::span<const uint16_t> matrix, std::span<float> scores) {
+    size_t rows = std::min(scores.size(), RowCount(query, matrix));
+    ScoreRows(SelectKernel(F16Metric::L2Sqr), query, matrix, 0, scores.first(rows));
+}
+
+std::vector<ScoredRow> TopKF16(std::span<const uint16_t> query, std::span<const uint16_t> matrix, size_t k,
+                               F16Metric metric) {
+    Kernel kernel = SelectKernel(metric);
+    // Orders rows best first, so the heap front is the worst row kept so far. NaNs go last and
+    // are equivalent to each other, which keeps this a strict weak ordering for the heap.
+    auto better = [metric](const ScoredRow &a, const ScoredRow &b) {
+        if (std::isnan(a.score) || std::isnan(b.score)) {
+            return !std::isnan(a.score) && std::isnan(b.score);
+        }
+        return metric == F16Metric::Dot ? a.score > b.score : a.score < b.score;
+    };
+    size_t rows = RowCount(query, matrix);
+    std::vector<ScoredRow> heap;
+    heap.reserve(std::min(k, rows));  // k may be SIZE_MAX to rank every row
+    float scores[TOP_K_BATCH];
+    for (size_t first_row = 0; first_row < rows && k > 0; first_row += TOP_K_BATCH) {
+        size_t count = std::min(TOP_K_BATCH, rows - first_row);
+        ScoreRows(kernel, query, matrix, first_row, std::span<float>(scores, count));
+        for (size_t i = 0; i < count; ++i) {
+            ScoredRow candidate{first_row + i, scores[i]};
+            if (heap.size() < k) {
+                heap.push_back(candidate);
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else if (better(candidate, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = candidate;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), better);
+    return heap;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Distance kernels over binary16 vectors. Elements are widened in registers and accumulated
+// in binary32 (F16C + FMA when available), no float copy of the data is ever made.
+
+// Both use the first min(a.size(), b.size()) elements
+float DotF16(std::span<const uint16_t> a, std::span<const uint16_t> b);
+float L2SqrF16(std::span<const uint16_t> a, std::span<const uint16_t> b);
+
+// `matrix` holds rows of query.size() elements one after another; scores[i] is computed
+// for row i, for min(scores.size(), number of rows) rows
+void DotF16Batch(std::span<const uint16_t> query, std::span<const uint16_t> matrix, std::span<float> scores);
+void L2SqrF16Batch(std::span<const uint16_t> query, std::span<const uint16_t> matrix, std::span<float> scores);
+
+enum class F16Metric {
+    Dot,    // Higher is better
+    L2Sqr,  // Lower is better
+};
+
+struct ScoredRow {
+    size_t row;
+    float score;
+};
+
+// Brute-force scan of a row-major matrix, returns at most k rows best first. A NaN score (from
+// NaN or infinite elements) ranks below every number.
+std::vector<ScoredRow> TopKF16(std::span<const uint16_t> query, std::span<const uint16_t> matrix, size_t k,
+                               F16Metric metric);
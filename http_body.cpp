@@ -0,0 +1,86 @@
+#include "http_body.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FdBodySource::FdBodySource(int fd, std::optional<std::uint64_t> size) : fd_(fd), size_(size) {
+
+}
+
+std::optional<std::uint64_t> FdBodySource::Size() const {
+    return size_;
+}
+
+std::size_t FdBodySource::Read(char *buffer, std::size_t capacity) {
+    while (true) {
+        ssize_t count = ::read(fd_, buffer, capacity);
+        if (count >= 0) {
+            return static_cast<std::size_t>(count);
+        }
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "FdBodySource::Read");
+        }
+    }
+}
+
+MappedFileBodySource::MappedFileBodySource(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat " + path);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if (size_ > 0) {
+        void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(data);
+    }
+    ::close(fd);
+}
+
+MappedFileBodySource::~MappedFileBodySource() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+std::optional<std::uint64_t> MappedFileBodySource::Size() const {
+    return size_;
+}
+
+std::size_t MappedFileBodySource::Read(char *buffer, std::size_t capacity) {
+    std::size_t count = std::min(capacity, size_ - offset_);
+    if (count > 0) {
+        std::memcpy(buffer, data_ + offset_, count);
+        offset_ += count;
+    }
+    return count;
+}
+
+GeneratorBodySource::GeneratorBodySource(Generator generator, std::optional<std::uint64_t> size)
+    : generator_(std::move(generator)), size_(size) {
+
+}
+
+std::optional<std::uint64_t> GeneratorBodySource::Size() const {
+    return size_;
+}
+
+std::size_t GeneratorBodySource::Read(char *buffer, std::size_t capacity) {
+    return generator_(buffer, capacity);
+}
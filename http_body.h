@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+// Produces a request body piece by piece, so it never has to be held in memory as a whole
+class HttpBodySource {
+public:
+    virtual ~HttpBodySource() = default;
+
+    // Total body length if it is known up front; otherwise the body is sent chunked
+    virtual std::optional<std::uint64_t> Size() const = 0;
+    // Copies at most `capacity` next bytes of the body into `buffer`, returns 0 at the end
+    virtual std::size_t Read(char *buffer, std::size_t capacity) = 0;
+};
+
+// Reads from a file descriptor (file, pipe, socket) that stays owned by the caller
+class FdBodySource : public HttpBodySource {
+public:
+    explicit FdBodySource(int fd, std::optional<std::uint64_t> size = std::nullopt);
+
+    std::optional<std::uint64_t> Size() const override;
+    std::size_t Read(char *buffer, std::size_t capacity) override;
+
+private:
+    int fd_;
+    std::optional<std::uint64_t> size_;
+};
+
+class MappedFileBodySource : public HttpBodySource {
+public:
+    explicit MappedFileBodySource(const std::string &path);
+    ~MappedFileBodySource() override;
+
+    MappedFileBodySource(const MappedFileBodySource &) = delete;
+    MappedFileBodySource &operator=(const MappedFileBodySource &) = delete;
+
+    std::optional<std::uint64_t> Size() const override;
+    std::size_t Read(char *buffer, std::size_t capacity) override;
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+};
+
+class GeneratorBodySource : public HttpBodySource {
+public:
+    // Same contract as HttpBodySource::Read
+    using Generator = std::function<std::size_t(char *buffer, std::size_t capacity)>;
+
+    explicit GeneratorBodySource(Generator generator, std::optional<std::uint64_t> size = std::nullopt);
+
+    std::optional<std::uint64_t> Size() const override;
+    std::size_t Read(char *buffer, std::size_t capacity) override;
+
+private:
+    Generator generator_;
+    std::optional<std::uint64_t> size_;
+};
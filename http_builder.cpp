@@ -1,31 +1,36 @@
 #include "http_builder.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+HttpHeaderCollection::HttpHeaderCollection(std::pmr::memory_resource *resource) : storage_(resource) {
 
-std::string LowerString(std::string_view str) {
-    std::string result;
-    for (char c : str) {
-        result += std::tolower(static_cast<unsigned char>(c));
-    }
-    return result;
 }
 
 std::string_view HttpHeaderCollection::GetValue(std::string_view name) const {
-    std::string name_lowercase = LowerString(name);
-    return storage_.at(name_lowercase).value;
+    auto it = storage_.find(name);
+    if (it == storage_.end()) {
+        throw std::out_of_range("HttpHeaderCollection::GetValue");
+    }
+    return it->second.value;
 }
 
 void HttpHeaderCollection::Set(std::string_view name, std::string_view value) {
-    std::string name_lowercase = LowerString(name);
-    if (Contains(name_lowercase)) {
-        storage_.at(name_lowercase).name = name;
-        storage_.at(name_lowercase).value = value;
+    auto it = storage_.find(name);
+    if (it != storage_.end()) {
+        it->second.name = name;
+        it->second.value = value;
     } else {
-        storage_[name_lowercase] = HttpHeader{std::string(name), std::string(value)};
+        storage_.emplace(std::piecewise_construct,
+                         std::forward_as_tuple(name),
+                         std::forward_as_tuple(name, value));
     }
 }
 
 void HttpHeaderCollection::Remove(std::string_view name) {
-    std::string name_lowercase = LowerString(name);
-    auto it = storage_.find(name_lowercase);
+    auto it = storage_.find(name);
     if (it != storage_.end()) {
         storage_.erase(it);
     }
@@ -36,8 +41,7 @@ std::size_t HttpHeaderCollection::Size() const {
 }
 
 bool HttpHeaderCollection::Contains(std::string_view name) const {
-    std::string name_lowercase = LowerString(name);
-    auto it = storage_.find(name_lowercase);
+    auto it = storage_.find(name);
     return it != storage_.end();
 }
 
@@ -53,9 +57,16 @@ HttpRequest::HttpRequest() {
 
 }
 
-std::string HttpRequest::ToString() const {
+HttpRequest::HttpRequest(std::pmr::memory_resource *resource)
+    : target_(resource), host_(resource), headers_(resource), body_(resource) {
+
+}
+
+std::string HttpRequest::Head() const {
     std::string result;
-    result += HttpMethodToString(method_) + " " + target_ + " HTTP/1.1\r\n";
+    result += HttpMethodToString(method_) + " ";
+    result += target_;
+    result += " HTTP/1.1\r\n";
     result += "Host: ";
     result += host_;
     if (port_.has_value()) {
@@ -63,15 +74,42 @@ std::string HttpRequest::ToString() const {
     }
     result += "\r\n";
     for (const auto& [key, header] : headers_.Items()) {
-        result += header.name + ": " + header.value + "\r\n";
+        result += header.name;
+        result += ": ";
+        result += header.value;
+        result += "\r\n";
     }
     result += "\r\n";
+    return result;
+}
+
+std::string HttpRequest::ToString() const {
+    if (body_source_) {
+        throw std::logic_error("HttpRequest::ToString: a streaming body can only be sent by Serializer or WriteTo");
+    }
+    std::string result = Head();
     if (has_body_) {
         result += body_;
     }
     return result;
 }
 
+void HttpRequest::WriteTo(int fd) const {
+    Serializer serializer(*this);
+    for (std::string_view piece = serializer.Next(); !piece.empty(); piece = serializer.Next()) {
+        while (!piece.empty()) {
+            ssize_t count = ::write(fd, piece.data(), piece.size());
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "HttpRequest::WriteTo");
+            }
+            piece.remove_prefix(static_cast<size_t>(count));
+        }
+    }
+}
+
 HttpMethod HttpRequest::GetMethod() const {
     return method_;
 }
@@ -93,16 +131,26 @@ const HttpHeaderCollection &HttpRequest::GetHeaders() const {
 }
 
 std::optional<std::string_view> HttpRequest::GetBody() const {
-    return has_body_ ? std::optional<std::string_view>(body_) : std::nullopt;
+    return has_body_ && !body_source_ ? std::optional<std::string_view>(body_) : std::nullopt;
+}
+
+std::shared_ptr<HttpBodySource> HttpRequest::GetBodySource() const {
+    return body_source_;
+}
+
+HttpRequest::Builder::Builder() : Builder(std::pmr::get_default_resource()) {
+
 }
 
-HttpRequest::Builder::Builder() {
+HttpRequest::Builder::Builder(std::pmr::memory_resource *resource)
+    : target_(resource), host_(resource), headers_(resource), body_(resource), query_params_(resource) {
     method_ = HttpMethod::Get;
     target_ = "/";
     host_ = "";
     port_ = std::nullopt;
     headers_.Clear();
     body_ = "";
+    body_source_.reset();
     query_params_.clear();
     has_body_ = false;
 }
@@ -114,6 +162,7 @@ HttpRequest::Builder &HttpRequest::Builder::Reset() {
     this->port_ = std::nullopt;
     this->headers_.Clear();
     this->body_ = "";
+    this->body_source_.reset();
     this->query_params_.clear();
     this->has_body_ = false;
     return *this;
@@ -125,11 +174,11 @@ HttpRequest::Builder &HttpRequest::Builder::SetMethod(HttpMethod method) {
 }
 
 HttpRequest::Builder &HttpRequest::Builder::SetTarget(std::string_view target) {
+    this->target_.clear();
     if (target.empty() || target[0] != '/') {
-        this->target_ = '/' + std::string(target);
-    } else {
-        this->target_ = target;
+        this->target_ += '/';
     }
+    this->target_ += target;
     return *this;
 }
 
@@ -182,7 +231,7 @@ HttpRequest::Builder &HttpRequest::Builder::SetPort(std::uint16_t port) {
 }
 
 HttpRequest::Builder &HttpRequest::Builder::SetQuery(std::string_view key, std::string_view value) {
-    query_params_.emplace_back(std::string(key), std::string(value));
+    query_params_.emplace_back(key, value);
     return *this;
 }
 
@@ -202,7 +251,7 @@ HttpRequest::Builder &HttpRequest::Builder::RemoveQuery(std::string_view key) {
 }
 
 HttpRequest::Builder &HttpRequest::Builder::SetHeader(std::string_view name, std::string_view value) {
-    if (LowerString(name) == "host") {
+    if (HttpHeaderNameEqual{}(name, "host")) {
         host_ = value;
     } else {
         headers_.Set(name, value);
@@ -212,7 +261,7 @@ HttpRequest::Builder &HttpRequest::Builder::SetHeader(std::string_view name, std
 
 HttpRequest::Builder &HttpRequest::Builder::RemoveHeader(std::string_view name) {
     headers_.Remove(name);
-    if (LowerString(name) == "host") {
+    if (HttpHeaderNameEqual{}(name, "host")) {
         host_ = "";
         port_ = std::nullopt;
     }
@@ -221,15 +270,36 @@ HttpRequest::Builder &HttpRequest::Builder::RemoveHeader(std::string_view name)
 
 HttpRequest::Builder &HttpRequest::Builder::SetBody(std::string_view data) {
     this->body_ = data;
+    this->body_source_.reset();
     this->has_body_ = true;
+    headers_.Remove("Transfer-Encoding");
     headers_.Set("Content-Length", std::to_string(data.size()));
     return *this;
 }
 
+HttpRequest::Builder &HttpRequest::Builder::SetBody(std::shared_ptr<HttpBodySource> source) {
+    if (!source) {
+        return SetNoBody();
+    }
+    this->body_ = "";
+    this->has_body_ = true;
+    if (auto size = source->Size()) {
+        headers_.Remove("Transfer-Encoding");
+        headers_.Set("Content-Length", std::to_string(*size));
+    } else {
+        headers_.Remove("Content-Length");
+        headers_.Set("Transfer-Encoding", "chunked");
+    }
+    this->body_source_ = std::move(source);
+    return *this;
+}
+
 HttpRequest::Builder &HttpRequest::Builder::SetNoBody() {
     this->body_ = "";
+    this->body_source_.reset();
     this->has_body_ = false;
     headers_.Remove("Content-Length");
+    headers_.Remove("Transfer-Encoding");
     return *this;
 }
 
@@ -250,42 +320,157 @@ std::string DecToHex(size_t dec) {
 	return result.empty() ? "0" : result;
 }
 
-std::string ApplyPercentEncoding(std::string_view str) {
-    std::string result;
+void AppendPercentEncoded(std::pmr::string &target, std::string_view str) {
+    constexpr std::string_view HEX_DIGITS = "0123456789ABCDEF";
     for (char c : str) {
         if (('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z') || ('0' <= c && c <= '9') ||
         c == '-' || c == '_' || c == '.' || c == '~') {
-            result += c;
+            target += c;
         } else {
-            size_t char_idx = static_cast<unsigned char>(c);
-            std::string hex = DecToHex(char_idx);
-            if (hex.length() < 2) {
-                hex = "0" + hex;
-            }
-            result += '%' + hex.substr(0, 2);
+            unsigned char byte = static_cast<unsigned char>(c);
+            target += '%';
+            target += HEX_DIGITS[byte >> 4];
+            target += HEX_DIGITS[byte & 0xf];
+        }
+    }
+}
+
+void HttpRequest::Builder::AppendQuery(std::pmr::string &target) const {
+    if (query_params_.empty()) {
+        return;
+    }
+    target += '?';
+    for (size_t i = 0; i < query_params_.size(); ++i) {
+        AppendPercentEncoded(target, query_params_[i].first);
+        target += '=';
+        AppendPercentEncoded(target, query_params_[i].second);
+        if (i < query_params_.size() - 1) {
+            target += '&';
         }
     }
-    return result;
 }
 
-HttpRequest HttpRequest::Builder::Build() const {
-    HttpRequest request;
+HttpRequest HttpRequest::Builder::Build() const & {
+    if (body_source_) {
+        throw std::logic_error("HttpRequest::Builder::Build: a streaming body cannot be shared, use std::move(builder).Build()");
+    }
+    HttpRequest request(target_.get_allocator().resource());
     request.method_ = method_;
     request.target_ = target_;
     request.host_ = host_;
     request.port_ = port_;
     request.body_ = body_;
+    request.body_source_ = body_source_;
     request.has_body_ = has_body_;
     request.headers_ = headers_;
-    if (!query_params_.empty()) {
-        std::string query_str;
-        for (size_t i = 0; i < query_params_.size(); ++i) {
-            query_str += ApplyPercentEncoding(query_params_[i].first) + '=' + ApplyPercentEncoding(query_params_[i].second);
-            if (i < query_params_.size() - 1) {
-                query_str += '&';
-            }
+    AppendQuery(request.target_);
+    return request;
+}
+
+HttpRequest HttpRequest::Builder::Build() && {
+    HttpRequest request(target_.get_allocator().resource());
+    request.method_ = method_;
+    request.target_ = std::move(target_);
+    request.host_ = std::move(host_);
+    request.port_ = port_;
+    request.body_ = std::move(body_);
+    request.body_source_ = std::move(body_source_);
+    request.has_body_ = has_body_;
+    request.headers_ = std::move(headers_);
+    AppendQuery(request.target_);
+    return request;
+}
+
+namespace {
+    constexpr std::string_view CRLF = "\r\n";
+    constexpr std::string_view LAST_CHUNK = "0\r\n\r\n";
+    constexpr size_t CHUNK_HEADER_RESERVE = 16 + CRLF.size();  // Up to 16 hex digits of the length
+}
+
+HttpRequest::Serializer::Serializer(const HttpRequest &request, std::size_t buffer_size) {
+    if (buffer_size < MIN_BUFFER_SIZE) {
+        throw std::invalid_argument("HttpRequest::Serializer: buffer is too small");
+    }
+    head_ = request.Head();
+    piece_size_ = buffer_size;
+    if (request.has_body_) {
+        if (request.body_source_) {
+            source_ = request.body_source_;
+            source_size_ = source_->Size();
+            buffer_.resize(buffer_size);  // Only a source needs somewhere to read into
+        } else {
+            body_ = request.body_;
         }
-        request.target_ += '?' + query_str;
     }
-    return request;
+}
+
+bool HttpRequest::Serializer::Done() const {
+    return stage_ == Stage::Done;
+}
+
+std::string_view HttpRequest::Serializer::Next() {
+    if (stage_ == Stage::Head) {
+        std::string_view piece = std::string_view(head_).substr(head_offset_, piece_size_);
+        head_offset_ += piece.size();
+        if (head_offset_ == head_.size()) {
+            stage_ = Stage::Body;
+        }
+        if (!piece.empty()) {
+            return piece;
+        }
+    }
+    if (stage_ == Stage::Body) {
+        if (source_) {
+            return NextSourcePiece();
+        }
+        std::string_view piece = body_.substr(body_offset_, piece_size_);
+        body_offset_ += piece.size();
+        if (body_offset_ == body_.size()) {
+            stage_ = Stage::Done;
+        }
+        if (!piece.empty()) {
+            return piece;
+        }
+    }
+    return {};
+}
+
+std::string_view HttpRequest::Serializer::NextSourcePiece() {
+    if (!source_size_.has_value()) {
+        return NextChunk();
+    }
+    std::uint64_t remaining = *source_size_ - source_sent_;
+    if (remaining == 0) {
+        stage_ = Stage::Done;
+        return {};
+    }
+    size_t capacity = static_cast<size_t>(std::min<std::uint64_t>(buffer_.size(), remaining));
+    size_t count = source_->Read(buffer_.data(), capacity);
+    if (count == 0) {
+        throw std::runtime_error("HttpRequest::Serializer: body source ended before Content-Length");
+    }
+    source_sent_ += count;
+    if (source_sent_ == *source_size_) {
+        stage_ = Stage::Done;
+    }
+    return std::string_view(buffer_.data(), count);
+}
+
+std::string_view HttpRequest::Serializer::NextChunk() {
+    // The payload is read right after the space reserved for the chunk size line,
+    // which is then written immediately in front of it
+    char *payload = buffer_.data() + CHUNK_HEADER_RESERVE;
+    size_t count = source_->Read(payload, buffer_.size() - CHUNK_HEADER_RESERVE - CRLF.size());
+    if (count == 0) {
+        stage_ = Stage::Done;
+        std::memcpy(buffer_.data(), LAST_CHUNK.data(), LAST_CHUNK.size());
+        return std::string_view(buffer_.data(), LAST_CHUNK.size());
+    }
+    char *start = payload - CRLF.size();
+    std::memcpy(start, CRLF.data(), CRLF.size());
+    for (size_t rest = count; rest > 0; rest /= 16) {
+        *--start = "0123456789ABCDEF"[rest % 16];
+    }
+    std::memcpy(payload + count, CRLF.data(), CRLF.size());
+    return std::string_view(start, payload + count + CRLF.size() - start);
 }
@@ -1,16 +1,20 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 #include <optional>
 #include <unordered_map>
+#include "http_body.h"
 
 enum class HttpMethod { Get, Head, Post, Put, Delete, Patch, Options };
 
-const std::string HttpMethodToString(HttpMethod method) {
+inline const std::string HttpMethodToString(HttpMethod method) {
     switch (method) {
         case HttpMethod::Get:
             return "GET";
@@ -31,13 +35,64 @@ const std::string HttpMethodToString(HttpMethod method) {
 }
 
 struct HttpHeader {
-    std::string name;
-    std::string value;
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    HttpHeader() = default;
+    HttpHeader(std::string_view name, std::string_view value, allocator_type alloc = {})
+        : name(name, alloc), value(value, alloc) {}
+    HttpHeader(const HttpHeader &other, allocator_type alloc)
+        : name(other.name, alloc), value(other.value, alloc) {}
+    HttpHeader(HttpHeader &&other, allocator_type alloc)
+        : name(std::move(other.name), alloc), value(std::move(other.value), alloc) {}
+    HttpHeader(const HttpHeader &other) = default;
+    HttpHeader(HttpHeader &&other) = default;
+    HttpHeader &operator=(const HttpHeader &other) = default;
+    HttpHeader &operator=(HttpHeader &&other) = default;
+
+    std::pmr::string name;
+    std::pmr::string value;
+};
+
+// Header names are case-insensitive; hashing and comparing them in place lets the map be
+// searched by any std::string_view spelling without building a lowercase key
+namespace http_detail {
+    constexpr char ToLowerAscii(char c) {
+        return 'A' <= c && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+}
+
+struct HttpHeaderNameHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view name) const {
+        std::uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+        for (char c : name) {
+            hash = (hash ^ static_cast<unsigned char>(http_detail::ToLowerAscii(c))) * 0x100000001b3;
+        }
+        return static_cast<std::size_t>(hash);
+    }
+};
+
+struct HttpHeaderNameEqual {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (http_detail::ToLowerAscii(a[i]) != http_detail::ToLowerAscii(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 class HttpHeaderCollection {
 public:
-    using Storage = std::unordered_map<std::string, HttpHeader>;
+    using Storage = std::pmr::unordered_map<std::pmr::string, HttpHeader, HttpHeaderNameHash, HttpHeaderNameEqual>;
+
+    HttpHeaderCollection() = default;
+    explicit HttpHeaderCollection(std::pmr::memory_resource *resource);
 
     std::string_view GetValue(std::string_view name) const;
     void Set(std::string_view name, std::string_view value);
@@ -52,7 +107,10 @@ private:
 
 class HttpRequest {
 public:
+    // A streaming body source is consumed as it is sent, so a request with one can be
+    // serialized only once, through Serializer or WriteTo; ToString throws std::logic_error
     std::string ToString() const;
+    void WriteTo(int fd) const;
 
     HttpMethod GetMethod() const;
     std::string_view GetTarget() const;
@@ -60,10 +118,46 @@ public:
     std::optional<std::uint16_t> GetPort() const;
     const HttpHeaderCollection &GetHeaders() const;
     std::optional<std::string_view> GetBody() const;
+    std::shared_ptr<HttpBodySource> GetBodySource() const;
+
+    // Produces the request in pieces of at most `buffer_size` bytes, so memory use does not
+    // depend on the body length. The request must outlive the serializer.
+    class Serializer {
+    public:
+        static constexpr std::size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+        static constexpr std::size_t MIN_BUFFER_SIZE = 64;
+
+        explicit Serializer(const HttpRequest &request, std::size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+        // The next piece, valid until the following call; empty once the request is complete
+        std::string_view Next();
+        bool Done() const;
+
+    private:
+        enum class Stage { Head, Body, Done };
+
+        Stage stage_ = Stage::Head;
+        std::string head_;
+        std::size_t head_offset_ = 0;
+        std::string_view body_;
+        std::size_t body_offset_ = 0;
+        std::shared_ptr<HttpBodySource> source_;
+        std::optional<std::uint64_t> source_size_;
+        std::uint64_t source_sent_ = 0;
+        std::size_t piece_size_;
+        std::vector<char> buffer_;  // Allocated only for a body source
+
+        std::string_view NextSourcePiece();
+        std::string_view NextChunk();
+    };
 
     class Builder {
     public:
         Builder();
+        // Every string, header and query parameter of the builder and of the requests it
+        // builds is allocated from `resource`, e.g. a std::pmr::monotonic_buffer_resource
+        // shared by a batch of requests. The resource must outlive all of them.
+        explicit Builder(std::pmr::memory_resource *resource);
 
         Builder &Reset();
 
@@ -89,28 +183,40 @@ public:
         Builder &RemoveHeader(std::string_view name);
 
         Builder &SetBody(std::string_view data);
+        // Content-Length is taken from the source size, otherwise the body is sent chunked.
+        // Only the rvalue Build() accepts a streaming body, since a source can be read once.
+        Builder &SetBody(std::shared_ptr<HttpBodySource> source);
         Builder &SetNoBody();
 
-        HttpRequest Build() const;
+        HttpRequest Build() const &;  // Throws std::logic_error for a streaming body
+        HttpRequest Build() &&;  // Moves the builder's storage into the request
 
     private:
         HttpMethod method_;
-        std::string target_;
-        std::string host_;
+        std::pmr::string target_;
+        std::pmr::string host_;
         std::optional<uint16_t> port_;
         HttpHeaderCollection headers_;
-        std::string body_;
+        std::pmr::string body_;
+        std::shared_ptr<HttpBodySource> body_source_;
         bool has_body_;
-        std::vector<std::pair<std::string, std::string>> query_params_;
+        std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> query_params_;
+
+        void AppendQuery(std::pmr::string &target) const;
     };
 
 private:
     HttpMethod method_;
-    std::string target_;
-    std::string host_;
+    std::pmr::string target_;
+    std::pmr::string host_;
     std::optional<uint16_t> port_;
     HttpHeaderCollection headers_;
-    std::string body_;
+    std::pmr::string body_;
+    std::shared_ptr<HttpBodySource> body_source_;
     bool has_body_;
+
+    std::string Head() const;
+
     HttpRequest();  // We prohibit creating new objects without Builder
+    explicit HttpRequest(std::pmr::memory_resource *resource);
 };
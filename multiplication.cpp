@@ -1,5 +1,170 @@
 #include "multiplication.h"
+#include "bitops.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MULTIPLICATION_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr uint32_t BITS_IN_UINT64 = 64;
+    constexpr uint32_t BITS_IN_UINT32 = 32;
+
+    size_t MinSize(size_t a, size_t b, size_t c) {
+        return std::min(a, std::min(b, c));
+    }
+
+    void MultiplyAccumulateScalar(const int32_t *a, const int32_t *b, int64_t *accumulator, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            accumulator[i] += Multiply(a[i], b[i]);
+        }
+    }
+
+    void MultiplyAccumulateScalar(const int64_t *a, const int64_t *b, int64_t *accumulator, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            uint64_t product = static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(b[i]);
+            accumulator[i] = static_cast<int64_t>(static_cast<uint64_t>(accumulator[i]) + product);
+        }
+    }
+
+#if defined(MULTIPLICATION_X86_SIMD)
+    // vpmuldq multiplies the sign-extended low halves of the 64-bit lanes: an exact int32 product
+    template <bool ACCUMULATE>
+    __attribute__((target("avx2")))
+    void MultiplyInt32Avx2(const int32_t *a, const int32_t *b, int64_t *result, size_t size) {
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+            __m256i y = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+            __m256i product = _mm256_mul_epi32(x, y);
+            if (ACCUMULATE) {
+                product = _mm256_add_epi64(product, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(result + i)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), product);
+        }
+        for (; i < size; ++i) {
+            result[i] = ACCUMULATE ? result[i] + Multiply(a[i], b[i]) : Multiply(a[i], b[i]);
+        }
+    }
+
+    // Low 64 bits of a 64x64 product from three vpmuludq: lo*lo + ((lo*hi + hi*lo) << 32)
+    __attribute__((target("avx2")))
+    __m256i MulLoEpi64(__m256i x, __m256i y) {
+        __m256i low = _mm256_mul_epu32(x, y);
+        __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(x, _mm256_srli_epi64(y, BITS_IN_UINT32)),
+                                         _mm256_mul_epu32(_mm256_srli_epi64(x, BITS_IN_UINT32), y));
+        return _mm256_add_epi64(low, _mm256_slli_epi64(cross, BITS_IN_UINT32));
+    }
+
+    __attribute__((target("avx2")))
+    void MultiplyAccumulateInt64Avx2(const int64_t *a, const int64_t *b, int64_t *accumulator, size_t size) {
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(accumulator + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(accumulator + i), _mm256_add_epi64(sum, MulLoEpi64(x, y)));
+        }
+        MultiplyAccumulateScalar(a + i, b + i, accumulator + i, size - i);
+    }
+#endif
+}
 
 int64_t Multiply(int a, int b) {
     return static_cast<int64_t>(a) * b;
 }
+
+unsigned __int128 MulWide(uint64_t a, uint64_t b) {
+    return static_cast<unsigned __int128>(a) * b;
+}
+
+__int128 MulWideSigned(int64_t a, int64_t b) {
+    return static_cast<__int128>(a) * b;
+}
+
+uint64_t MulHi(uint64_t a, uint64_t b) {
+    return static_cast<uint64_t>(MulWide(a, b) >> BITS_IN_UINT64);
+}
+
+int64_t MulHiSigned(int64_t a, int64_t b) {
+    return static_cast<int64_t>(MulWideSigned(a, b) >> BITS_IN_UINT64);
+}
+
+void MultiplySpan(std::span<const int32_t> a, std::span<const int32_t> b, std::span<int64_t> result) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+#if defined(MULTIPLICATION_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return MultiplyInt32Avx2<false>(a.data(), b.data(), result.data(), size);
+    }
+#endif
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = Multiply(a[i], b[i]);
+    }
+}
+
+void MultiplyAccumulate(std::span<const int32_t> a, std::span<const int32_t> b, std::span<int64_t> accumulator) {
+    size_t size = MinSize(a.size(), b.size(), accumulator.size());
+#if defined(MULTIPLICATION_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return MultiplyInt32Avx2<true>(a.data(), b.data(), accumulator.data(), size);
+    }
+#endif
+    MultiplyAccumulateScalar(a.data(), b.data(), accumulator.data(), size);
+}
+
+void MultiplyAccumulate(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> accumulator) {
+    size_t size = MinSize(a.size(), b.size(), accumulator.size());
+#if defined(MULTIPLICATION_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return MultiplyAccumulateInt64Avx2(a.data(), b.data(), accumulator.data(), size);
+    }
+#endif
+    MultiplyAccumulateScalar(a.data(), b.data(), accumulator.data(), size);
+}
+
+ConstantDivider::ConstantDivider(uint64_t divisor) : divisor_(divisor), magic_(0), shift_(0) {
+    if (divisor == 0) {
+        throw std::invalid_argument("ConstantDivider: division by zero");
+    }
+    is_power_of_two_ = IsPowerOfTwo(divisor);
+    if (is_power_of_two_) {
+        shift_ = CountTrailingZeros(divisor);
+        return;
+    }
+    // With l = ceil(log2(d)): magic = floor(2^64 * (2^l - d) / d) + 1, which fits into 64 bits
+    shift_ = BITS_IN_UINT64 - CountLeadingZeros(divisor - 1);
+    unsigned __int128 numerator = static_cast<unsigned __int128>(RoundUpToPowerOfTwo(divisor) - divisor) << BITS_IN_UINT64;
+    magic_ = static_cast<uint64_t>(numerator / divisor) + 1;
+}
+
+uint64_t ConstantDivider::Divisor() const {
+    return divisor_;
+}
+
+uint64_t ConstantDivider::Divide(uint64_t value) const {
+    if (is_power_of_two_) {
+        return value >> shift_;
+    }
+    uint64_t high = MulHi(magic_, value);
+    return (high + ((value - high) >> 1)) >> (shift_ - 1);
+}
+
+uint64_t ConstantDivider::Modulo(uint64_t value) const {
+    return value - Divide(value) * divisor_;
+}
+
+void ConstantDivider::DivideSpan(std::span<const uint64_t> values, std::span<uint64_t> result) const {
+    size_t size = std::min(values.size(), result.size());
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = Divide(values[i]);
+    }
+}
+
+void ConstantDivider::ModuloSpan(std::span<const uint64_t> values, std::span<uint64_t> result) const {
+    size_t size = std::min(values.size(), result.size());
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = Modulo(values[i]);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+int64_t Multiply(int a, int b);
+
+// Full 128-bit products and their upper halves. The signed versions have their own names so
+// that calls with int or unsigned long long arguments are never ambiguous.
+unsigned __int128 MulWide(uint64_t a, uint64_t b);
+__int128 MulWideSigned(int64_t a, int64_t b);
+uint64_t MulHi(uint64_t a, uint64_t b);
+int64_t MulHiSigned(int64_t a, int64_t b);
+
+// Element-wise over the first min(...) elements of the spans; AVX2 (vpmuldq / vpmuludq) when available.
+// result[i] = Multiply(a[i], b[i])
+void MultiplySpan(std::span<const int32_t> a, std::span<const int32_t> b, std::span<int64_t> result);
+// accumulator[i] += a[i] * b[i], exact for 32-bit inputs, wrapping modulo 2^64 for 64-bit ones
+void MultiplyAccumulate(std::span<const int32_t> a, std::span<const int32_t> b, std::span<int64_t> accumulator);
+void MultiplyAccumulate(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> accumulator);
+
+// Division and modulo by a runtime constant through a precomputed magic number
+// (Granlund-Montgomery): a multiply-high, an add and shifts instead of a div instruction
+class ConstantDivider {
+public:
+    explicit ConstantDivider(uint64_t divisor);
+
+    uint64_t Divisor() const;
+    uint64_t Divide(uint64_t value) const;
+    uint64_t Modulo(uint64_t value) const;
+
+    void DivideSpan(std::span<const uint64_t> values, std::span<uint64_t> result) const;
+    void ModuloSpan(std::span<const uint64_t> values, std::span<uint64_t> result) const;
+
+private:
+    uint64_t divisor_;
+    uint64_t magic_;
+    uint32_t shift_;
+    bool is_power_of_two_;
+};
@@ -0,0 +1,195 @@
+#include "rank_select.h"
+#include "bitops.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr uint64_t BITS_IN_WORD = 64;
+    constexpr uint64_t COUNTS_PER_CACHE_LINE = 32;
+
+    uint64_t WordCount(uint64_t size) {
+        return (size + BITS_IN_WORD - 1) / BITS_IN_WORD;
+    }
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __attribute__((target("bmi,bmi2")))
+    uint32_t SelectBitInWordBmi2(uint64_t value, uint32_t rank) {
+        return static_cast<uint32_t>(_tzcnt_u64(_pdep_u64(uint64_t{1} << rank, value)));
+    }
+#endif
+
+    uint32_t SelectInWord(uint64_t value, uint32_t rank) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        if (GetCpuFeatures().bmi2) {
+            return SelectBitInWordBmi2(value, rank);
+        }
+#endif
+        return SelectBitInWord(value, rank);
+    }
+}
+
+RankSelectBitVector::RankSelectBitVector(std::vector<uint64_t> words, uint64_t size) : size_(size) {
+    if (words.size() < WordCount(size)) {
+        throw std::invalid_argument("RankSelectBitVector: not enough words for the size");
+    }
+    auto owned = std::make_shared<const std::vector<uint64_t>>(std::move(words));
+    words_ = std::span<const uint64_t>(*owned);
+    owner_ = std::move(owned);
+    BuildIndex();
+}
+
+RankSelectBitVector::RankSelectBitVector(std::span<const uint64_t> words, uint64_t size)
+    : RankSelectBitVector(nullptr, words, size) {
+
+}
+
+RankSelectBitVector::RankSelectBitVector(std::shared_ptr<const void> owner, std::span<const uint64_t> words,
+                                         uint64_t size)
+    : owner_(std::move(owner)), words_(words), size_(size) {
+    if (words.size() < WordCount(size)) {
+        throw std::invalid_argument("RankSelectBitVector: not enough words for the size");
+    }
+    BuildIndex();
+}
+
+RankSelectBitVector RankSelectBitVector::FromMappedFile(const std::string &path, uint64_t size) {
+    size_t length = WordCount(size) * sizeof(uint64_t);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat " + path);
+    }
+    if (static_cast<uint64_t>(info.st_size) < length) {
+        ::close(fd);
+        throw std::invalid_argument("RankSelectBitVector: " + path + " is shorter than the bitvector");
+    }
+    if (length == 0) {
+        ::close(fd);
+        return RankSelectBitVector(nullptr, {}, 0);
+    }
+    void *data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "mmap " + path);
+    }
+    std::shared_ptr<const void> mapping(data, [length](const void *ptr) {
+        ::munmap(const_cast<void *>(ptr), length);
+    });
+    std::span<const uint64_t> words(static_cast<const uint64_t *>(data), length / sizeof(uint64_t));
+    return RankSelectBitVector(std::move(mapping), words, size);
+}
+
+uint64_t RankSelectBitVector::Word(uint64_t index) const {
+    if (index >= WordCount(size_)) {
+        return 0;
+    }
+    uint64_t bits_in_word = std::min(BITS_IN_WORD, size_ - index * BITS_IN_WORD);
+    return ExtractBits(words_[index], 0, bits_in_word);
+}
+
+void RankSelectBitVector::BuildIndex() {
+    uint64_t num_blocks = size_ / (WORDS_PER_BLOCK * BITS_IN_WORD) + 1;
+    superblocks_.assign((num_blocks - 1) / BLOCKS_PER_SUPERBLOCK + 1, 0);
+    blocks_.assign((num_blocks + COUNTS_PER_CACHE_LINE - 1) / COUNTS_PER_CACHE_LINE, BlockCounts{});
+    select_samples_.clear();
+
+    uint64_t ones = 0;
+    for (uint64_t block = 0; block < num_blocks; ++block) {
+        if (block % BLOCKS_PER_SUPERBLOCK == 0) {
+            superblocks_[block / BLOCKS_PER_SUPERBLOCK] = ones;
+        }
+        uint64_t relative = ones - superblocks_[block / BLOCKS_PER_SUPERBLOCK];
+        blocks_[block / COUNTS_PER_CACHE_LINE].counts[block % COUNTS_PER_CACHE_LINE] = static_cast<uint16_t>(relative);
+        for (uint64_t word = block * WORDS_PER_BLOCK; word < (block + 1) * WORDS_PER_BLOCK; ++word) {
+            ones += CountSetBits(Word(word));
+        }
+        while (select_samples_.size() * SELECT_SAMPLE_RATE < ones) {
+            select_samples_.push_back(static_cast<uint32_t>(block));
+        }
+    }
+    select_samples_.push_back(static_cast<uint32_t>(num_blocks - 1));
+    ones_ = ones;
+}
+
+uint64_t RankSelectBitVector::BlockRank(uint64_t block) const {
+    return superblocks_[block / BLOCKS_PER_SUPERBLOCK] +
+           blocks_[block / COUNTS_PER_CACHE_LINE].counts[block % COUNTS_PER_CACHE_LINE];
+}
+
+uint64_t RankSelectBitVector::Size() const {
+    return size_;
+}
+
+uint64_t RankSelectBitVector::CountOnes() const {
+    return ones_;
+}
+
+bool RankSelectBitVector::Get(uint64_t index) const {
+    return ExtractBits(words_[index / BITS_IN_WORD], index % BITS_IN_WORD, 1);
+}
+
+uint64_t RankSelectBitVector::Rank1(uint64_t index) const {
+    index = std::min(index, size_);
+    uint64_t block = index / (WORDS_PER_BLOCK * BITS_IN_WORD);
+    uint64_t last_word = index / BITS_IN_WORD;
+    uint64_t result = BlockRank(block);
+    for (uint64_t word = block * WORDS_PER_BLOCK; word < last_word; ++word) {
+        result += CountSetBits(words_[word]);
+    }
+    if (index % BITS_IN_WORD != 0) {
+        result += CountSetBits(ExtractBits(words_[last_word], 0, index % BITS_IN_WORD));
+    }
+    return result;
+}
+
+uint64_t RankSelectBitVector::Rank0(uint64_t index) const {
+    index = std::min(index, size_);
+    return index - Rank1(index);
+}
+
+uint64_t RankSelectBitVector::Select1(uint64_t rank) const {
+    if (rank >= ones_) {
+        return size_;
+    }
+    // The answer lies between the blocks holding the surrounding samples; find the last
+    // block whose rank does not exceed the requested one
+    uint64_t low = select_samples_[rank / SELECT_SAMPLE_RATE];
+    uint64_t high = select_samples_[rank / SELECT_SAMPLE_RATE + 1];
+    while (low < high) {
+        uint64_t middle = low + (high - low + 1) / 2;
+        if (BlockRank(middle) <= rank) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    uint64_t remaining = rank - BlockRank(low);
+    uint64_t word = low * WORDS_PER_BLOCK;
+    uint64_t bits = Word(word);
+    for (uint64_t count = CountSetBits(bits); remaining >= count; count = CountSetBits(bits)) {
+        remaining -= count;
+        bits = Word(++word);
+    }
+    return word * BITS_IN_WORD + SelectInWord(bits, static_cast<uint32_t>(remaining));
+}
+
+size_t RankSelectBitVector::IndexBytes() const {
+    return superblocks_.size() * sizeof(uint64_t) + blocks_.size() * sizeof(BlockCounts) +
+           select_samples_.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Static bitvector with constant-time rank and fast select. Bit i lives in word i / 64 at
+// position i % 64. The index adds under 4% to the size of the bits: an absolute count per
+// 64 Kibit superblock, a 16-bit relative count per 512-bit block (one cache line of data,
+// 32 counts per cache line of index) and a sampled position for every 8192nd set bit.
+class RankSelectBitVector {
+public:
+    RankSelectBitVector(std::vector<uint64_t> words, uint64_t size);
+    // Does not copy the bits; `words` must outlive the bitvector (e.g. an mmapped region)
+    RankSelectBitVector(std::span<const uint64_t> words, uint64_t size);
+    // Maps the file read-only and keeps the mapping for the lifetime of the bitvector
+    static RankSelectBitVector FromMappedFile(const std::string &path, uint64_t size);
+
+    uint64_t Size() const;
+    uint64_t CountOnes() const;
+    bool Get(uint64_t index) const;
+
+    // Number of set bits in [0, index)
+    uint64_t Rank1(uint64_t index) const;
+    uint64_t Rank0(uint64_t index) const;
+    // Position of the set bit with the given zero-based rank, Size() if there is none
+    uint64_t Select1(uint64_t rank) const;
+
+    // Bytes taken by the rank/select index, not counting the bits themselves
+    size_t IndexBytes() const;
+
+private:
+    static constexpr uint64_t WORDS_PER_BLOCK = 8;
+    static constexpr uint64_t BLOCKS_PER_SUPERBLOCK = 128;
+    static constexpr uint64_t SELECT_SAMPLE_RATE = 8192;
+
+    struct alignas(64) BlockCounts {
+        uint16_t counts[32];
+    };
+
+    std::shared_ptr<const void> owner_;
+    std::span<const uint64_t> words_;
+    uint64_t size_;
+    uint64_t ones_ = 0;
+    std::vector<uint64_t> superblocks_;
+    std::vector<BlockCounts> blocks_;
+    std::vector<uint32_t> select_samples_;
+
+    RankSelectBitVector(std::shared_ptr<const void> owner, std::span<const uint64_t> words, uint64_t size);
+
+    void BuildIndex();
+    uint64_t Word(uint64_t index) const;
+    uint64_t BlockRank(uint64_t block) const;
+};
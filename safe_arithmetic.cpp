@@ -1,36 +1,40 @@
 #include "safe_arithmetic.h"
+#include "bitops.h"
+#include <algorithm>
 #include <limits>
 
-bool SafeAdd(int64_t a, int64_t b, int64_t& result) {    
-    if (b > 0 && a > INT64_MAX - b) {
-        return false;
-    } else if (b < 0 && a < INT64_MIN - b) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SAFE_ARITHMETIC_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+bool SafeAdd(int64_t a, int64_t b, int64_t& result) {
+    int64_t sum;
+    if (__builtin_add_overflow(a, b, &sum)) {
         return false;
     }
 
-    result = a + b;
+    result = sum;
     return true;
 }
 
 bool SafeSubtract(int64_t a, int64_t b, int64_t& result) {
-    if (b > 0 && a < INT64_MIN + b) {
-        return false;
-    } else if (b < 0 && a > INT64_MAX + b) {
+    int64_t difference;
+    if (__builtin_sub_overflow(a, b, &difference)) {
         return false;
     }
 
-    result = a - b;
+    result = difference;
     return true;
 }
 
 bool SafeMultiply(int64_t a, int64_t b, int64_t& result) {
-    if (b > 0 && (a < INT64_MIN / b || a > INT64_MAX / b)) {
-        return false;
-    } else if (b < 0 && (a < INT64_MAX / b || a > INT64_MIN / b)) {
+    int64_t product;
+    if (__builtin_mul_overflow(a, b, &product)) {
         return false;
     }
 
-    result = a * b;
+    result = product;
     return true;
 }
 
@@ -44,3 +48,202 @@ bool SafeDivide(int64_t a, int64_t b, int64_t& result) {
     result = a / b;
     return true;
 }
+
+namespace {
+    constexpr size_t BITS_IN_WORD = 64;
+    constexpr int SIGN_SHIFT = 63;
+
+    // Sign bit set iff a + b overflowed into `sum`
+    inline int64_t AddOverflowSign(int64_t a, int64_t b, int64_t sum) {
+        return (a ^ sum) & (b ^ sum);
+    }
+
+    inline int64_t WrappingAdd(int64_t a, int64_t b) {
+        return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+    }
+
+    // The value an overflowing a + x saturates to: a's side of the range
+    inline int64_t SaturationFor(int64_t a) {
+        return (a >> SIGN_SHIFT) ^ INT64_MAX;
+    }
+
+    size_t SafeAddScalar(const int64_t* a, const int64_t* b, int64_t* result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            if (__builtin_add_overflow(a[i], b[i], &result[i])) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    size_t SafeSubtractScalar(const int64_t* a, const int64_t* b, int64_t* result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            if (__builtin_sub_overflow(a[i], b[i], &result[i])) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    void SaturatingAddScalar(const int64_t* a, const int64_t* b, int64_t* result, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            result[i] = SaturatingAdd(a[i], b[i]);
+        }
+    }
+
+    size_t MinSize(size_t a, size_t b, size_t c) {
+        return std::min(a, std::min(b, c));
+    }
+
+#if defined(SAFE_ARITHMETIC_X86_SIMD)
+    // Adds (or subtracts) four lanes at a time and stops at the first block whose
+    // overflow mask, the sign bits of AddOverflowSign, is not empty
+    template <bool SUBTRACT>
+    __attribute__((target("avx2,bmi")))
+    size_t SafeAddAvx2(const int64_t* a, const int64_t* b, int64_t* result, size_t size) {
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i sum = SUBTRACT ? _mm256_sub_epi64(x, y) : _mm256_add_epi64(x, y);
+            // For x - y the second operand that must differ in sign from the result is ~y
+            __m256i other = SUBTRACT ? _mm256_xor_si256(y, _mm256_set1_epi64x(-1)) : y;
+            __m256i overflow = _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(other, sum));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), sum);
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(overflow)));
+            if (mask != 0) {
+                return i + _tzcnt_u32(mask);
+            }
+        }
+        size_t tail = SUBTRACT ? SafeSubtractScalar(a + i, b + i, result + i, size - i)
+                               : SafeAddScalar(a + i, b + i, result + i, size - i);
+        return i + tail;
+    }
+
+    __attribute__((target("avx2")))
+    void SaturatingAddAvx2(const int64_t* a, const int64_t* b, int64_t* result, size_t size) {
+        const __m256i max = _mm256_set1_epi64x(INT64_MAX);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i sum = _mm256_add_epi64(x, y);
+            __m256i overflow = _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum));
+            // x >> 63 is all ones for negative x; there is no 64-bit arithmetic shift in AVX2
+            __m256i saturated = _mm256_xor_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), x), max);
+            __m256i chosen = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(sum), _mm256_castsi256_pd(saturated),
+                                                                  _mm256_castsi256_pd(overflow)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), chosen);
+        }
+        SaturatingAddScalar(a + i, b + i, result + i, size - i);
+    }
+#endif
+}
+
+size_t SafeAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+#if defined(SAFE_ARITHMETIC_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return SafeAddAvx2<false>(a.data(), b.data(), result.data(), size);
+    }
+#endif
+    return SafeAddScalar(a.data(), b.data(), result.data(), size);
+}
+
+size_t SafeSubtractSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+#if defined(SAFE_ARITHMETIC_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return SafeAddAvx2<true>(a.data(), b.data(), result.data(), size);
+    }
+#endif
+    return SafeSubtractScalar(a.data(), b.data(), result.data(), size);
+}
+
+size_t SafeMultiplySpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+    for (size_t i = 0; i < size; ++i) {
+        if (__builtin_mul_overflow(a[i], b[i], &result[i])) {
+            return i;
+        }
+    }
+    return size;
+}
+
+size_t SafeAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result,
+                   std::span<uint64_t> overflow) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+    size = std::min(size, overflow.size() * BITS_IN_WORD);
+    size_t count = 0;
+    // Branch-free so that the compiler can vectorize each 64-element word
+    for (size_t word = 0; word * BITS_IN_WORD < size; ++word) {
+        size_t begin = word * BITS_IN_WORD;
+        size_t end = std::min(size, begin + BITS_IN_WORD);
+        uint64_t bits = 0;
+        for (size_t i = begin; i < end; ++i) {
+            int64_t sum = WrappingAdd(a[i], b[i]);
+            result[i] = sum;
+            bits |= static_cast<uint64_t>(static_cast<uint64_t>(AddOverflowSign(a[i], b[i], sum)) >> SIGN_SHIFT) << (i - begin);
+        }
+        overflow[word] = bits;
+        count += CountSetBits(bits);
+    }
+    return count;
+}
+
+bool SafeSum(std::span<const int64_t> values, int64_t& result) {
+    // A 128-bit accumulator cannot overflow for fewer than 2^64 int64_t values
+    __int128 sum = 0;
+    for (int64_t value : values) {
+        sum += value;
+    }
+    if (sum < INT64_MIN || sum > INT64_MAX) {
+        return false;
+    }
+    result = static_cast<int64_t>(sum);
+    return true;
+}
+
+bool SafeDot(std::span<const int64_t> a, std::span<const int64_t> b, int64_t& result) {
+    size_t size = std::min(a.size(), b.size());
+    // Every product fits into 128 bits; only an astronomically long input can overflow the sum
+    __int128 sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (__builtin_add_overflow(sum, static_cast<__int128>(a[i]) * b[i], &sum)) {
+            return false;
+        }
+    }
+    if (sum < INT64_MIN || sum > INT64_MAX) {
+        return false;
+    }
+    result = static_cast<int64_t>(sum);
+    return true;
+}
+
+int64_t SaturatingAdd(int64_t a, int64_t b) {
+    int64_t result;
+    return __builtin_add_overflow(a, b, &result) ? SaturationFor(a) : result;
+}
+
+int64_t SaturatingSubtract(int64_t a, int64_t b) {
+    int64_t result;
+    return __builtin_sub_overflow(a, b, &result) ? SaturationFor(a) : result;
+}
+
+int64_t SaturatingMultiply(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_mul_overflow(a, b, &result)) {
+        return (a < 0) != (b < 0) ? INT64_MIN : INT64_MAX;
+    }
+    return result;
+}
+
+void SaturatingAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result) {
+    size_t size = MinSize(a.size(), b.size(), result.size());
+#if defined(SAFE_ARITHMETIC_X86_SIMD)
+    if (GetCpuFeatures().avx2) {
+        return SaturatingAddAvx2(a.data(), b.data(), result.data(), size);
+    }
+#endif
+    SaturatingAddScalar(a.data(), b.data(), result.data(), size);
+}
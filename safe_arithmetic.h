@@ -0,0 +1,138 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+// Each returns false and leaves `result` untouched if the exact result does not fit into int64_t
+bool SafeAdd(int64_t a, int64_t b, int64_t& result);
+bool SafeSubtract(int64_t a, int64_t b, int64_t& result);
+bool SafeMultiply(int64_t a, int64_t b, int64_t& result);
+bool SafeDivide(int64_t a, int64_t b, int64_t& result);
+
+// Element-wise operations over the first min(a.size(), b.size(), result.size()) elements.
+// Return the index of the first element that overflows, or that count if none does;
+// result elements from the returned index on are unspecified.
+size_t SafeAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result);
+size_t SafeSubtractSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result);
+size_t SafeMultiplySpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result);
+
+// Processes every element instead of stopping: bit i % 64 of overflow[i / 64] is set if
+// element i overflowed (its result is then unspecified). `overflow` needs a bit per element.
+// Returns the number of overflowing elements.
+size_t SafeAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result,
+                   std::span<uint64_t> overflow);
+
+// Exact reductions: return false if the true sum / dot product does not fit into int64_t,
+// however the intermediate values behave
+bool SafeSum(std::span<const int64_t> values, int64_t& result);
+bool SafeDot(std::span<const int64_t> a, std::span<const int64_t> b, int64_t& result);
+
+// Clamp to the int64_t range instead of failing
+int64_t SaturatingAdd(int64_t a, int64_t b);
+int64_t SaturatingSubtract(int64_t a, int64_t b);
+int64_t SaturatingMultiply(int64_t a, int64_t b);
+void SaturatingAddSpan(std::span<const int64_t> a, std::span<const int64_t> b, std::span<int64_t> result);
+
+// Integer that remembers whether any operation producing it overflowed, so existing
+// expression code can be checked once at the end: `(Checked(a) * b + c).Overflowed()`
+template <typename T>
+class Checked {
+    static_assert(std::is_integral_v<T>, "Checked needs an integer type");
+
+public:
+    constexpr Checked() = default;
+    constexpr Checked(T value) : value_(value) {}
+
+    // Unspecified if Overflowed()
+    constexpr T Value() const {
+        return value_;
+    }
+
+    constexpr bool Overflowed() const {
+        return overflowed_;
+    }
+
+    friend constexpr Checked operator+(Checked a, Checked b) {
+        Checked result;
+        result.overflowed_ = __builtin_add_overflow(a.value_, b.value_, &result.value_) | a.overflowed_ | b.overflowed_;
+        return result;
+    }
+
+    friend constexpr Checked operator-(Checked a, Checked b) {
+        Checked result;
+        result.overflowed_ = __builtin_sub_overflow(a.value_, b.value_, &result.value_) | a.overflowed_ | b.overflowed_;
+        return result;
+    }
+
+    friend constexpr Checked operator*(Checked a, Checked b) {
+        Checked result;
+        result.overflowed_ = __builtin_mul_overflow(a.value_, b.value_, &result.value_) | a.overflowed_ | b.overflowed_;
+        return result;
+    }
+
+    friend constexpr Checked operator/(Checked a, Checked b) {
+        Checked result;
+        bool invalid = b.value_ == 0;
+        if constexpr (std::is_signed_v<T>) {
+            invalid |= a.value_ == std::numeric_limits<T>::min() && b.value_ == -1;
+        }
+        result.value_ = invalid ? 0 : a.value_ / b.value_;
+        result.overflowed_ = invalid | a.overflowed_ | b.overflowed_;
+        return result;
+    }
+
+    // The remainder always fits, so only a zero divisor overflows; min % -1 is 0 rather than
+    // the undefined behaviour of the built-in operator
+    friend constexpr Checked operator%(Checked a, Checked b) {
+        Checked result;
+        bool invalid = b.value_ == 0;
+        bool zero = invalid;
+        if constexpr (std::is_signed_v<T>) {
+            zero |= b.value_ == -1;
+        }
+        result.value_ = zero ? 0 : a.value_ % b.value_;
+        result.overflowed_ = invalid | a.overflowed_ | b.overflowed_;
+        return result;
+    }
+
+    // Compare the values alone; the outcome is unspecified if either side Overflowed()
+    friend constexpr bool operator==(Checked a, Checked b) {
+        return a.value_ == b.value_;
+    }
+
+    friend constexpr std::strong_ordering operator<=>(Checked a, Checked b) {
+        return a.value_ <=> b.value_;
+    }
+
+    constexpr Checked operator-() const {
+        return Checked(0) - *this;
+    }
+
+    constexpr Checked& operator+=(Checked other) {
+        return *this = *this + other;
+    }
+
+    constexpr Checked& operator-=(Checked other) {
+        return *this = *this - other;
+    }
+
+    constexpr Checked& operator*=(Checked other) {
+        return *this = *this * other;
+    }
+
+    constexpr Checked& operator/=(Checked other) {
+        return *this = *this / other;
+    }
+
+    constexpr Checked& operator%=(Checked other) {
+        return *this = *this % other;
+    }
+
+private:
+    T value_ = 0;
+    bool overflowed_ = false;
+};
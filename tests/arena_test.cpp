@@ -0,0 +1,261 @@
+// FixedPool across threads: slots and counts drained at thread exit, cache entries of
+// destroyed pools pruned, the locked fallback once a thread's cache is gone, frees from other
+// threads, and Stats() totals balancing; plus Arena alignment and Release.
+// Build from the repository root with sanitizers and run; exits non-zero on failure:
+//   g++ -std=c++20 -O1 -fsanitize=address,undefined -I. tests/arena_test.cpp arena.cpp -o arena_test
+
+#include "arena.h"
+#include "tests/check.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Live blocks of the global heap, which holds the per-thread pool caches
+std::atomic<long> live_heap_blocks = 0;
+
+void *operator new(size_t size) {
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    ++live_heap_blocks;
+    return ptr;
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    size_t align = static_cast<size_t>(alignment);
+    void *ptr = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    ++live_heap_blocks;
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr != nullptr) {
+        --live_heap_blocks;
+        std::free(ptr);
+    }
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace {
+    bool Balanced(const AllocatorStats &stats) {
+        return stats.allocations == stats.deallocations && stats.bytes_in_use == 0;
+    }
+
+    void TestArena() {
+        Arena arena(100);
+        {
+            std::pmr::vector<std::pmr::string> strings(&arena);
+            for (size_t i = 0; i < 10000; ++i) {
+                strings.emplace_back(i % 200, 'x');
+            }
+            bool same = true;
+            for (size_t i = 0; i < strings.size(); ++i) {
+                same &= strings[i].size() == i % 200;
+            }
+            Check(same, "Arena-backed strings keep their contents");
+        }
+        for (size_t alignment : {1, 2, 8, 64, 4096, 8192}) {
+            void *ptr = arena.allocate(3, alignment);
+            Check(reinterpret_cast<uintptr_t>(ptr) % alignment == 0, "Arena alignment " + std::to_string(alignment));
+            std::memset(ptr, 1, 3);
+        }
+        std::memset(arena.allocate(Arena::MAX_BLOCK_SIZE * 5, 64), 0, Arena::MAX_BLOCK_SIZE * 5);
+        Check(arena.Stats().bytes_reserved >= arena.Stats().bytes_in_use, "Arena reserves what it hands out");
+        arena.Release();
+        Check(arena.Stats().bytes_reserved == 0, "Arena::Release returns every block");
+        Check(arena.allocate(10) != nullptr, "Arena allocates again after Release");
+    }
+
+    // A thread frees everything it allocated and exits: its counts reach Stats() and its
+    // cached slots are reused by the next thread instead of new chunks being reserved
+    void TestThreadExitDrains() {
+        FixedPool pool;
+        constexpr size_t COUNT = 10000;
+        auto churn = [&pool] {
+            std::vector<void *> slots;
+            for (size_t i = 0; i < COUNT; ++i) {
+                slots.push_back(pool.allocate(64));
+            }
+            for (void *slot : slots) {
+                pool.deallocate(slot, 64);
+            }
+        };
+        std::thread(churn).join();
+        AllocatorStats first = pool.Stats();
+        Check(first.allocations == COUNT && Balanced(first), "exited thread's counts are published");
+        std::thread(churn).join();
+        AllocatorStats second = pool.Stats();
+        Check(second.allocations == 2 * COUNT && Balanced(second), "second thread's counts are published");
+        Check(second.bytes_reserved == first.bytes_reserved, "exited thread's slots are reused");
+    }
+
+    // Pools destroyed by another thread leave entries in this thread's cache until it next
+    // starts using a pool; without pruning the heap would keep one entry per dead pool
+    void TestDeadPoolsArePruned() {
+        constexpr size_t POOLS = 2000;
+        long growth = 0;
+        std::thread([&] {
+            FixedPool warm_up;
+            warm_up.deallocate(warm_up.allocate(16), 16);
+            long before = live_heap_blocks;
+            std::vector<FixedPool *> pools;
+            for (size_t i = 0; i < POOLS; ++i) {
+                pools.push_back(new FixedPool);
+                pools.back()->deallocate(pools.back()->allocate(16), 16);
+            }
+            std::thread([&] {
+                for (FixedPool *pool : pools) {
+                    delete pool;
+                }
+            }).join();
+            pools = {};
+            FixedPool fresh;
+            fresh.deallocate(fresh.allocate(16), 16);
+            growth = live_heap_blocks - before;
+        }).join();
+        Check(growth < static_cast<long>(POOLS / 10), "cache entries of pools destroyed elsewhere are dropped, " +
+                                                          std::to_string(growth) + " blocks left");
+
+        // Pools created and destroyed on the same thread must not accumulate either
+        std::thread([&] {
+            FixedPool warm_up;
+            warm_up.deallocate(warm_up.allocate(16), 16);
+            long before = live_heap_blocks;
+            for (size_t i = 0; i < POOLS; ++i) {
+                FixedPool pool;
+                pool.deallocate(pool.allocate(32), 32);
+            }
+            growth = live_heap_blocks - before;
+        }).join();
+        Check(growth < static_cast<long>(POOLS / 10), "cache entries of pools destroyed locally are dropped, " +
+                                                          std::to_string(growth) + " blocks left");
+    }
+
+    // thread_local destructors run in reverse order of construction, so this one, built
+    // before the thread first touches a pool, runs after the thread's pool cache is gone
+    struct LateUser {
+        FixedPool *pool = nullptr;
+        std::pmr::vector<std::pmr::string> *strings = nullptr;
+
+        ~LateUser() {
+            if (pool == nullptr) {
+                return;
+            }
+            delete strings;  // Frees slots allocated while the cache was alive
+            std::pmr::vector<std::pmr::string> late(pool);
+            for (size_t i = 0; i < 100; ++i) {
+                late.emplace_back(40 + i % 50, 'z');
+            }
+        }
+    };
+
+    thread_local LateUser late_user;
+
+    void TestFallbackAfterCacheDestroyed() {
+        FixedPool pool;
+        std::thread([&] {
+            late_user.pool = &pool;
+            late_user.strings = new std::pmr::vector<std::pmr::string>(&pool);
+            for (size_t i = 0; i < 1000; ++i) {
+                late_user.strings->emplace_back(30 + i % 50, 'a');
+            }
+        }).join();
+        Check(Balanced(pool.Stats()), "frees and allocations after the thread cache is gone are counted");
+    }
+
+    // Slots are freed by whichever thread picks them up, with every size and alignment
+    void TestCrossThreadFrees() {
+        FixedPool pool;
+        std::mutex mutex;
+        std::deque<std::pair<void *, size_t>> handed_over;
+        std::atomic<uint64_t> allocations = 0;
+        std::atomic<bool> bad_alignment = false;
+        auto free = [&pool](std::pair<void *, size_t> entry) {
+            pool.deallocate(entry.first, entry.second & 0xffffffff, entry.second >> 32);
+        };
+        auto work = [&](uint32_t seed) {
+            std::mt19937 random(seed);
+            std::vector<std::pair<void *, size_t>> mine;
+            for (size_t i = 0; i < 100000; ++i) {
+                if (random() % 3 != 0) {
+                    size_t size = 1 + random() % (random() % 10 == 0 ? 10000 : 300);
+                    size_t alignment = size_t{1} << (random() % 7);
+                    void *ptr = pool.allocate(size, alignment);
+                    bad_alignment = bad_alignment || reinterpret_cast<uintptr_t>(ptr) % alignment != 0;
+                    std::memset(ptr, static_cast<int>(seed), size);
+                    mine.push_back({ptr, size | alignment << 32});
+                    ++allocations;
+                }
+                if (!mine.empty() && (mine.size() > 500 || random() % 2 == 0)) {
+                    if (random() % 2 == 0) {
+                        std::lock_guard lock(mutex);
+                        handed_over.push_back(mine.back());
+                    } else {
+                        free(mine.back());
+                    }
+                    mine.pop_back();
+                }
+                if (random() % 4 == 0) {
+                    std::unique_lock lock(mutex);
+                    if (!handed_over.empty()) {
+                        auto entry = handed_over.front();
+                        handed_over.pop_front();
+                        lock.unlock();
+                        free(entry);
+                    }
+                }
+            }
+            for (auto entry : mine) {
+                free(entry);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (uint32_t seed = 1; seed <= 4; ++seed) {
+            threads.emplace_back(work, seed);
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (auto entry : handed_over) {
+            free(entry);
+        }
+        AllocatorStats stats = pool.Stats();
+        Check(!bad_alignment, "FixedPool honours the requested alignment");
+        Check(stats.allocations == allocations, "Stats() counts every allocation of every thread");
+        Check(Balanced(stats), "Stats() balances after frees from other threads");
+        Check(stats.Fragmentation() >= 0 && stats.Fragmentation() <= 1, "Fragmentation() is a share");
+    }
+}
+
+int main() {
+    TestArena();
+    TestThreadExitDrains();
+    TestDeadPoolsArePruned();
+    TestFallbackAfterCacheDestroyed();
+    TestCrossThreadFrees();
+    return TestResult();
+}
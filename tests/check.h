@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Failure counting shared by the standalone tests. Every failed Check counts, but only the
+// first MAX_REPORTED_FAILURES are printed so an exhaustive sweep cannot flood the output.
+inline constexpr int MAX_REPORTED_FAILURES = 20;
+
+inline int failures = 0;
+
+inline void Check(bool condition, const std::string &what) {
+    if (!condition && failures++ < MAX_REPORTED_FAILURES) {
+        std::printf("FAILED: %s\n", what.c_str());
+    }
+}
+
+// Prints the verdict; the value to return from main
+inline int TestResult() {
+    if (failures > MAX_REPORTED_FAILURES) {
+        std::printf("... %d more failures\n", failures - MAX_REPORTED_FAILURES);
+    }
+    std::printf("%s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
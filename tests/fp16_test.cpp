@@ -0,0 +1,208 @@
+// Exhaustive checks of the binary16 and bfloat16 conversions: every one of the 65536 inputs
+// through the scalar function and through each span kernel that the CPU can run, and every
+// one of the 2^32 binary32 inputs through the encoders. fp16.cpp is included directly so the
+// kernels normally picked by the dispatch can all be called.
+// Build from the repository root and run (about a minute); exits non-zero on failure:
+//   g++ -std=c++20 -O2 -I. tests/fp16_test.cpp bitops.cpp -o fp16_test
+
+#include "fp16.cpp"
+#include "tests/check.h"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr size_t FLOAT16_COUNT = 1 << 16;
+
+    std::string Hex(uint32_t value) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "0x%x", value);
+        return buffer;
+    }
+
+    // Straight from the definition: (-1)^sign * 2^(exp - 15) * 1.man, or 2^-14 * 0.man when
+    // exp is 0; NaNs become quiet binary32 NaNs with the payload in the top mantissa bits
+    uint32_t ReferenceFloat16ToFloatBits(uint16_t half) {
+        uint32_t sign = half >> 15;
+        uint32_t exp = (half >> 10) & 0x1f;
+        uint32_t man = half & 0x3ff;
+        if (exp == 0x1f) {
+            return sign << 31 | 0x7f800000 | (man != 0 ? 0x400000 : 0) | man << 13;
+        }
+        double magnitude = exp == 0 ? std::ldexp(man, -24) : std::ldexp(1024 + man, static_cast<int>(exp) - 25);
+        return std::bit_cast<uint32_t>(static_cast<float>(sign ? -magnitude : magnitude));
+    }
+
+    using DecodeKernel = void (*)(const uint16_t *, float *, size_t);
+
+    // Runs the kernel over every input at once and over short lengths that end in its scalar tail
+    void CheckDecodeKernel(const char *name, DecodeKernel kernel, const std::vector<uint16_t> &halves,
+                           const std::vector<uint32_t> &expected) {
+        std::vector<float> result(halves.size());
+        kernel(halves.data(), result.data(), halves.size());
+        for (size_t i = 0; i < halves.size(); ++i) {
+            uint32_t bits = std::bit_cast<uint32_t>(result[i]);
+            Check(bits == expected[i], std::string(name) + "(" + Hex(halves[i]) + ") = " + Hex(bits) +
+                                           ", expected " + Hex(expected[i]));
+        }
+        for (size_t size = 0; size <= 40; ++size) {
+            size_t offset = 0x7bf0 - size / 2;  // Around the largest finite values and infinity
+            std::vector<float> part(size + 1, -1.0f);
+            kernel(halves.data() + offset, part.data(), size);
+            bool same = part[size] == -1.0f;
+            for (size_t i = 0; i < size; ++i) {
+                same = same && std::bit_cast<uint32_t>(part[i]) == expected[offset + i];
+            }
+            Check(same, std::string(name) + " over " + std::to_string(size) + " values");
+        }
+    }
+
+    void TestFloat16ToFloat() {
+        std::vector<uint16_t> halves(FLOAT16_COUNT);
+        std::vector<uint32_t> expected(FLOAT16_COUNT);
+        for (size_t i = 0; i < FLOAT16_COUNT; ++i) {
+            halves[i] = static_cast<uint16_t>(i);
+            expected[i] = ReferenceFloat16ToFloatBits(halves[i]);
+        }
+        for (size_t i = 0; i < FLOAT16_COUNT; ++i) {
+            uint32_t bits = std::bit_cast<uint32_t>(ConvertFloat16ToFloat(halves[i]));
+            Check(bits == expected[i], "ConvertFloat16ToFloat(" + Hex(halves[i]) + ") = " + Hex(bits) +
+                                           ", expected " + Hex(expected[i]));
+        }
+        CheckDecodeKernel("scalar", ConvertFloat16ToFloatScalar, halves, expected);
+        CheckDecodeKernel("ConvertFloat16ToFloatSpan", [](const uint16_t *values, float *result, size_t size) {
+            ConvertFloat16ToFloatSpan(std::span(values, size), std::span(result, size));
+        }, halves, expected);
+#if defined(FP16_X86_SIMD)
+        if (GetCpuFeatures().f16c) {
+            CheckDecodeKernel("F16C", ConvertFloat16ToFloatF16c, halves, expected);
+        } else {
+            std::printf("skipped: no F16C\n");
+        }
+        if (GetCpuFeatures().avx512f) {
+            CheckDecodeKernel("AVX-512", ConvertFloat16ToFloatAvx512, halves, expected);
+        } else {
+            std::printf("skipped: no AVX-512\n");
+        }
+#endif
+    }
+
+    // Decoding and encoding again gives the same bits back; NaNs only gain the quiet bit
+    void TestRoundTrips() {
+        for (uint32_t i = 0; i < FLOAT16_COUNT; ++i) {
+            uint16_t half = static_cast<uint16_t>(i);
+            bool is_nan = (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+            uint16_t expected = is_nan ? half | 0x200 : half;
+            uint16_t result = ConvertFloatToFloat16(ConvertFloat16ToFloat(half));
+            Check(result == expected, "binary16 round trip of " + Hex(half) + " gives " + Hex(result));
+
+            uint16_t bfloat = static_cast<uint16_t>(i);
+            is_nan = (bfloat & 0x7f80) == 0x7f80 && (bfloat & 0x7f) != 0;
+            expected = is_nan ? bfloat | 0x40 : bfloat;
+            result = ConvertFloatToBFloat16(ConvertBFloat16ToFloat(bfloat));
+            Check(result == expected, "bfloat16 round trip of " + Hex(bfloat) + " gives " + Hex(result));
+        }
+    }
+
+    void TestEncoderCases() {
+        struct Case {
+            float value;
+            uint16_t expected;
+        };
+        const Case cases[] = {
+            {65504.0f, 0x7bff},                    // Largest finite
+            {65519.996f, 0x7bff},                  // Just below the halfway point to 2^16
+            {65520.0f, 0x7c00},                    // Halfway rounds to even, which overflows
+            {1e10f, 0x7c00},
+            {-1e10f, 0xfc00},
+            {std::ldexp(1.0f, -24), 0x0001},       // Smallest subnormal
+            {std::ldexp(1.0f, -25), 0x0000},       // Halfway to it rounds to even zero
+            {std::ldexp(1.5f, -25), 0x0001},
+            {std::ldexp(3.0f, -25), 0x0002},       // 1.5 ulp rounds to even 2
+            {std::ldexp(1023.0f, -24), 0x03ff},    // Largest subnormal
+            {std::ldexp(2047.0f, -25), 0x0400},    // Rounds up into the smallest normal
+            {1.0f + std::ldexp(1.0f, -11), 0x3c00},  // Tie between 1 and its successor goes to 1
+            {1.0f + std::ldexp(3.0f, -11), 0x3c02},  // Tie goes up to the even mantissa
+            {-0.0f, 0x8000},
+            {std::bit_cast<float>(0x7f800001u), 0x7e00},  // Payload below binary16 bits is quiet NaN
+            {std::bit_cast<float>(0xffc02000u), 0xfe01},  // Sign and top payload bits are kept
+        };
+        for (const Case &test : cases) {
+            uint16_t result = ConvertFloatToFloat16(test.value);
+            Check(result == test.expected, "ConvertFloatToFloat16(" + Hex(std::bit_cast<uint32_t>(test.value)) +
+                                               ") = " + Hex(result) + ", expected " + Hex(test.expected));
+        }
+    }
+
+    // Round to nearest even on the dropped 16 bits, NaNs made quiet
+    uint16_t ReferenceFloatToBFloat16(uint32_t bits) {
+        if ((bits & 0x7fffffff) > 0x7f800000) {
+            return static_cast<uint16_t>((bits >> 16) | 0x40);
+        }
+        uint32_t upper = bits >> 16;
+        uint32_t lower = bits & 0xffff;
+        if (lower > 0x8000 || (lower == 0x8000 && (upper & 1))) {
+            ++upper;
+        }
+        return static_cast<uint16_t>(upper);
+    }
+
+    using EncodeKernel = void (*)(const float *, uint16_t *, size_t);
+
+    // Every binary32 bit pattern through the scalar encoders and each vector kernel; the F16C
+    // and AVX-512 kernels are vcvtps2ph, the reference the scalar binary16 encoder must match
+    void TestEncodersOnEveryFloat() {
+        constexpr size_t CHUNK = size_t{1} << 20;
+        struct Kernel {
+            const char *name;
+            EncodeKernel kernel;
+            bool bfloat16;
+        };
+        std::vector<Kernel> kernels = {{"binary16 scalar", ConvertFloatToFloat16Scalar, false},
+                                       {"bfloat16 scalar", ConvertFloatToBFloat16Scalar, true}};
+#if defined(FP16_X86_SIMD)
+        if (GetCpuFeatures().f16c) {
+            kernels.push_back({"binary16 F16C", ConvertFloatToFloat16F16c, false});
+        }
+        if (GetCpuFeatures().avx512f) {
+            kernels.push_back({"binary16 AVX-512", ConvertFloatToFloat16Avx512, false});
+        }
+        if (GetCpuFeatures().avx2) {
+            kernels.push_back({"bfloat16 AVX2", ConvertFloatToBFloat16Avx2, true});
+        }
+#endif
+        std::vector<float> floats(CHUNK);
+        std::vector<uint16_t> expected_half(CHUNK);
+        std::vector<uint16_t> expected_bfloat(CHUNK);
+        std::vector<uint16_t> result(CHUNK);
+        for (uint64_t start = 0; start < (uint64_t{1} << 32); start += CHUNK) {
+            for (size_t i = 0; i < CHUNK; ++i) {
+                uint32_t bits = static_cast<uint32_t>(start + i);
+                floats[i] = std::bit_cast<float>(bits);
+                expected_half[i] = ConvertFloatToFloat16(floats[i]);
+                expected_bfloat[i] = ReferenceFloatToBFloat16(bits);
+            }
+            for (const Kernel &kernel : kernels) {
+                kernel.kernel(floats.data(), result.data(), CHUNK);
+                const std::vector<uint16_t> &expected = kernel.bfloat16 ? expected_bfloat : expected_half;
+                if (result != expected) {
+                    size_t i = std::mismatch(result.begin(), result.end(), expected.begin()).first - result.begin();
+                    Check(false, std::string(kernel.name) + "(" + Hex(static_cast<uint32_t>(start + i)) + ") = " +
+                                     Hex(result[i]) + ", expected " + Hex(expected[i]));
+                }
+            }
+        }
+        std::printf("checked %zu encoders on all 2^32 floats\n", kernels.size());
+    }
+}
+
+int main() {
+    TestFloat16ToFloat();
+    TestRoundTrips();
+    TestEncoderCases();
+    TestEncodersOnEveryFloat();
+    return TestResult();
+}
@@ -0,0 +1,222 @@
+// HttpRequest serialization over a socketpair: in-memory and streaming bodies, chunked framing
+// at the smallest serializer buffer, sources that end before their Content-Length, and the
+// paths that refuse to read a streaming body twice.
+// Build from the repository root and run; exits non-zero on failure:
+//   g++ -std=c++20 -O2 -I. tests/http_body_test.cpp http_builder.cpp http_body.cpp -o http_body_test
+
+#include "http_body.h"
+#include "http_builder.h"
+#include "tests/check.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    // Everything `send` writes into one end of a socketpair, as read from the other end
+    // by a second thread, so large bodies cannot fill the socket buffer and block
+    std::string SendOverSocket(const std::function<void(int fd)> &send) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::perror("socketpair");
+            std::exit(2);
+        }
+        std::string received;
+        std::thread reader([&] {
+            char buffer[4096];
+            ssize_t count;
+            while ((count = ::read(fds[1], buffer, sizeof(buffer))) > 0) {
+                received.append(buffer, static_cast<size_t>(count));
+            }
+        });
+        std::exception_ptr error;
+        try {
+            send(fds[0]);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        ::close(fds[0]);
+        reader.join();
+        ::close(fds[1]);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return received;
+    }
+
+    // Writes the request piece by piece from a serializer with the given buffer size
+    std::string SerializeOverSocket(const HttpRequest &request, size_t buffer_size, size_t &largest_piece) {
+        largest_piece = 0;
+        return SendOverSocket([&](int fd) {
+            HttpRequest::Serializer serializer(request, buffer_size);
+            for (std::string_view piece = serializer.Next(); !piece.empty(); piece = serializer.Next()) {
+                largest_piece = std::max(largest_piece, piece.size());
+                while (!piece.empty()) {
+                    ssize_t count = ::write(fd, piece.data(), piece.size());
+                    if (count <= 0) {
+                        throw std::runtime_error("write to socketpair failed");
+                    }
+                    piece.remove_prefix(static_cast<size_t>(count));
+                }
+            }
+        });
+    }
+
+    std::string Body(size_t size) {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            body[i] = static_cast<char>('a' + i % 26);
+        }
+        return body;
+    }
+
+    // A generator producing `body` in reads of at most `step` bytes, then ending
+    std::shared_ptr<HttpBodySource> Generator(const std::string &body, std::optional<uint64_t> size,
+                                              size_t step = SIZE_MAX) {
+        auto offset = std::make_shared<size_t>(0);
+        return std::make_shared<GeneratorBodySource>(
+            [body, offset, step](char *buffer, size_t capacity) {
+                size_t count = std::min({capacity, step, body.size() - *offset});
+                body.copy(buffer, count, *offset);
+                *offset += count;
+                return count;
+            },
+            size);
+    }
+
+    // The payload of a chunked body, or nullopt if the framing is malformed
+    std::optional<std::string> Dechunk(std::string_view chunked) {
+        std::string payload;
+        while (true) {
+            size_t line_end = chunked.find("\r\n");
+            if (line_end == std::string_view::npos || line_end == 0) {
+                return std::nullopt;
+            }
+            size_t length = std::stoul(std::string(chunked.substr(0, line_end)), nullptr, 16);
+            chunked.remove_prefix(line_end + 2);
+            if (chunked.size() < length + 2 || chunked.substr(length, 2) != "\r\n") {
+                return std::nullopt;
+            }
+            if (length == 0) {
+                return chunked.size() == 2 ? std::optional(payload) : std::nullopt;
+            }
+            payload += chunked.substr(0, length);
+            chunked.remove_prefix(length + 2);
+        }
+    }
+
+    void TestInMemoryBody() {
+        std::string body = Body(100000);
+        HttpRequest request = HttpRequest::Builder().Post("/upload").SetHost("example.com").SetBody(body).Build();
+        std::string expected = request.ToString();
+        Check(expected.ends_with("\r\n\r\n" + body), "ToString ends with the body");
+        Check(expected.find("Content-Length: 100000\r\n") != std::string::npos, "ToString has Content-Length");
+        Check(SendOverSocket([&](int fd) { request.WriteTo(fd); }) == expected, "WriteTo sends what ToString returns");
+        size_t largest = 0;
+        std::string sent = SerializeOverSocket(request, HttpRequest::Serializer::MIN_BUFFER_SIZE, largest);
+        Check(sent == expected, "64-byte serializer sends what ToString returns");
+        Check(largest <= HttpRequest::Serializer::MIN_BUFFER_SIZE, "64-byte serializer pieces fit the buffer");
+
+        HttpRequest empty = HttpRequest::Builder().Get("/").SetHost("example.com").Build();
+        Check(empty.ToString().ends_with("\r\n\r\n"), "request without a body ends after the head");
+    }
+
+    void TestChunked(size_t body_size, size_t step) {
+        std::string body = Body(body_size);
+        HttpRequest::Builder builder;
+        builder.Post("/").SetHost("example.com").SetBody(Generator(body, std::nullopt, step));
+        HttpRequest request = std::move(builder).Build();
+        size_t largest = 0;
+        std::string sent = SerializeOverSocket(request, HttpRequest::Serializer::MIN_BUFFER_SIZE, largest);
+        std::string what = "chunked body of " + std::to_string(body_size) + " in reads of " + std::to_string(step);
+        size_t head_end = sent.find("\r\n\r\n");
+        Check(head_end != std::string::npos, what + ": head is terminated");
+        std::string head = sent.substr(0, head_end + 4);
+        Check(head.find("Transfer-Encoding: chunked\r\n") != std::string::npos, what + ": Transfer-Encoding");
+        Check(head.find("Content-Length") == std::string::npos, what + ": no Content-Length");
+        Check(Dechunk(std::string_view(sent).substr(head_end + 4)) == body, what + ": framing and payload");
+        Check(largest <= HttpRequest::Serializer::MIN_BUFFER_SIZE, what + ": pieces fit the buffer");
+    }
+
+    void TestContentLengthSource() {
+        std::string body = Body(300000);
+        HttpRequest::Builder builder;
+        builder.Put("/").SetHost("example.com").SetBody(Generator(body, body.size(), 1000));
+        HttpRequest request = std::move(builder).Build();
+        std::string sent = SendOverSocket([&](int fd) { request.WriteTo(fd); });
+        Check(sent.find("Content-Length: 300000\r\n") != std::string::npos, "sized source has Content-Length");
+        Check(sent.ends_with("\r\n\r\n" + body), "sized source is sent unframed");
+
+        std::string path = "/tmp/http_body_test_" + std::to_string(::getpid());
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+        std::fwrite(body.data(), 1, body.size(), file);
+        std::fclose(file);
+        HttpRequest::Builder mapped_builder;
+        mapped_builder.Put("/").SetHost("example.com").SetBody(std::make_shared<MappedFileBodySource>(path));
+        HttpRequest mapped = std::move(mapped_builder).Build();
+        ::unlink(path.c_str());
+        Check(SendOverSocket([&](int fd) { mapped.WriteTo(fd); }) == sent, "mapped file is sent like the generator");
+    }
+
+    void TestSourceEndsEarly() {
+        std::string body = Body(1000);
+        for (size_t buffer_size : {HttpRequest::Serializer::MIN_BUFFER_SIZE, HttpRequest::Serializer::DEFAULT_BUFFER_SIZE}) {
+            HttpRequest::Builder builder;
+            builder.Post("/").SetHost("example.com").SetBody(Generator(body, 1001));
+            HttpRequest request = std::move(builder).Build();
+            bool thrown = false;
+            size_t largest = 0;
+            try {
+                SerializeOverSocket(request, buffer_size, largest);
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            Check(thrown, "source ending before Content-Length throws, buffer " + std::to_string(buffer_size));
+        }
+    }
+
+    void TestSingleUse() {
+        HttpRequest::Builder builder;
+        builder.Post("/").SetHost("example.com").SetBody(Generator("body", std::nullopt));
+        bool thrown = false;
+        try {
+            builder.Build();
+        } catch (const std::logic_error &) {
+            thrown = true;
+        }
+        Check(thrown, "Build() const & throws for a streaming body");
+
+        HttpRequest request = std::move(builder).Build();
+        thrown = false;
+        try {
+            request.ToString();
+        } catch (const std::logic_error &) {
+            thrown = true;
+        }
+        Check(thrown, "ToString throws for a streaming body");
+        std::string sent = SendOverSocket([&](int fd) { request.WriteTo(fd); });
+        Check(sent.ends_with("\r\n\r\n4\r\nbody\r\n0\r\n\r\n"), "body is still sent after the refused ToString");
+    }
+}
+
+int main() {
+    TestInMemoryBody();
+    for (size_t body_size : {0, 1, 43, 44, 45, 88, 5000}) {
+        for (size_t step : {size_t{1}, size_t{7}, SIZE_MAX}) {
+            TestChunked(body_size, step);
+        }
+    }
+    TestContentLengthSource();
+    TestSourceEndsEarly();
+    TestSingleUse();
+    return TestResult();
+}
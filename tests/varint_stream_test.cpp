@@ -0,0 +1,144 @@
+// VarintReader / VarintWriter round trips over pipes and memory, and malformed input.
+// Build from the repository root and run; exits non-zero on failure:
+//   g++ -std=c++20 -O2 -I. tests/varint_stream_test.cpp varint_stream.cpp varint.cpp bitops.cpp -o varint_stream_test
+
+#include "tests/check.h"
+#include "varint.h"
+#include "varint_stream.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+    std::vector<uint64_t> RandomValues(size_t count, uint64_t seed) {
+        std::mt19937_64 random(seed);
+        std::vector<uint64_t> values(count);
+        for (uint64_t &value : values) {
+            value = random() >> (random() % 64);
+        }
+        return values;
+    }
+
+    // Runs `write` on a thread feeding one end of a pipe and returns the read end
+    template <typename Write>
+    int PipeFrom(Write write, std::thread &writer) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            std::perror("pipe");
+            std::exit(1);
+        }
+        writer = std::thread([write, fd = fds[1]] {
+            write(fd);
+            ::close(fd);
+        });
+        return fds[0];
+    }
+
+    void TestRoundTripThroughPipe() {
+        std::vector<uint64_t> values = RandomValues(100000, 1);
+        std::thread writer;
+        int fd = PipeFrom([&values](int out) {
+            VarintWriter stream(out, MAX_VARINT_SIZE);  // Smallest buffer: every value is split
+            for (size_t i = 0; i < values.size(); i += 7) {
+                stream.WriteBatch(std::span<const uint64_t>(values).subspan(i, std::min<size_t>(7, values.size() - i)));
+            }
+        }, writer);
+        VarintReader reader(fd, 16);
+        std::vector<uint64_t> decoded(values.size());
+        size_t done = reader.ReadBatch(std::span<uint64_t>(decoded).first(1000));
+        for (; done < decoded.size(); ++done) {
+            if (!reader.Read(decoded[done])) {
+                break;
+            }
+        }
+        uint64_t extra;
+        Check(done == values.size() && decoded == values, "pipe round trip");
+        Check(!reader.Read(extra) && !reader.Failed(), "clean end of a pipe");
+        writer.join();
+        ::close(fd);
+    }
+
+    void TestRoundTripThroughMemory() {
+        std::vector<uint64_t> values = RandomValues(1000, 2);
+        std::vector<uint8_t> memory(values.size() * MAX_VARINT_SIZE);
+        uint64_t size;
+        {
+            VarintWriter writer(memory.data(), memory.size());
+            Check(writer.WriteBatch(values), "write into memory");
+            size = writer.BytesWritten();
+        }
+        VarintReader reader(memory.data(), size);
+        std::vector<uint64_t> decoded(values.size() + 1);
+        Check(reader.ReadBatch(decoded) == values.size() && !reader.Failed(), "memory round trip count");
+        decoded.pop_back();
+        Check(decoded == values, "memory round trip values");
+    }
+
+    // Small batches over a large memory region: each one must cost only the values it reads,
+    // otherwise this takes minutes and trips the alarm
+    void TestManySmallBatchesFromMemory() {
+        std::vector<uint64_t> values = RandomValues(size_t{1} << 22, 3);
+        std::vector<uint8_t> memory(values.size() * MAX_VARINT_SIZE);
+        VarintWriter writer(memory.data(), memory.size());
+        Check(writer.WriteBatch(values), "write into memory");
+        VarintReader reader(memory.data(), writer.BytesWritten());
+        std::vector<uint64_t> decoded(values.size());
+        size_t done = 0;
+        for (size_t batch = 1; done < decoded.size(); batch = batch % 100 + 1) {
+            size_t count = std::min(batch, decoded.size() - done);
+            count = reader.ReadBatch(std::span<uint64_t>(decoded).subspan(done, count));
+            if (count == 0) {
+                break;
+            }
+            done += count;
+        }
+        Check(done == values.size() && decoded == values && !reader.Failed(), "small batches from memory");
+    }
+
+    // A full buffer without any terminating byte can never become a value
+    void TestUnterminatedInputThroughPipe() {
+        std::thread writer;
+        int fd = PipeFrom([](int out) {
+            std::vector<uint8_t> bytes(64, 0xff);
+            Check(::write(out, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size()), "pipe write");
+        }, writer);
+        VarintReader reader(fd, 32);
+        std::vector<uint64_t> values(8);
+        Check(reader.ReadBatch(values) == 0 && reader.Failed(), "unterminated input fails ReadBatch");
+        writer.join();
+        ::close(fd);
+    }
+
+    void TestMalformedInputInMemory() {
+        std::vector<uint8_t> unterminated(64, 0xff);
+        std::vector<uint64_t> values(8);
+        VarintReader batch_reader(unterminated.data(), unterminated.size());
+        Check(batch_reader.ReadBatch(values) == 0 && batch_reader.Failed(), "unterminated memory fails ReadBatch");
+
+        // Ten bytes with the last one above 1 overflow 64 bits
+        std::vector<uint8_t> overflow = {0x05, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02};
+        VarintReader reader(overflow.data(), overflow.size());
+        uint64_t value;
+        Check(reader.Read(value) && value == 5, "value before the overflow");
+        Check(reader.ReadBatch(values) == 0 && reader.Failed(), "overflowing value fails");
+
+        std::vector<uint8_t> truncated = {0x01, 0x80};
+        VarintReader truncated_reader(truncated.data(), truncated.size());
+        Check(truncated_reader.Read(value) && value == 1, "value before truncation");
+        Check(!truncated_reader.Read(value) && truncated_reader.Failed(), "truncated value fails");
+    }
+}
+
+int main() {
+    ::alarm(30);  // A hang is a failure too
+    TestRoundTripThroughPipe();
+    TestRoundTripThroughMemory();
+    TestManySmallBatchesFromMemory();
+    TestUnterminatedInputThroughPipe();
+    TestMalformedInputInMemory();
+    return TestResult();
+}
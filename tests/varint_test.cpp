@@ -0,0 +1,164 @@
+// Fuzzed round trips of every IntegerCodec and of DecodeVarints, plus truncated and corrupted
+// input. Build from the repository root with sanitizers and run; exits non-zero on failure:
+//   g++ -std=c++20 -O1 -fsanitize=address,undefined -I. tests/varint_test.cpp varint.cpp bitops.cpp -o varint_test
+
+#include "tests/check.h"
+#include "varint.h"
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr IntegerCodec CODECS[] = {IntegerCodec::Varint, IntegerCodec::Delta, IntegerCodec::DeltaOfDelta,
+                                       IntegerCodec::GroupVarint, IntegerCodec::FrameOfReference};
+    constexpr const char *CODEC_NAMES[] = {"Varint", "Delta", "DeltaOfDelta", "GroupVarint", "FrameOfReference"};
+    constexpr uint64_t MAX_VALUE = std::numeric_limits<uint64_t>::max();
+
+    // Sequences the codecs are meant for, their worst cases and the block boundaries
+    std::vector<std::vector<uint64_t>> Sequences(std::mt19937_64 &random) {
+        std::vector<std::vector<uint64_t>> sequences;
+        sequences.push_back({0});
+        sequences.push_back({MAX_VALUE});
+        sequences.push_back({0, MAX_VALUE, 0, MAX_VALUE, 1});
+        sequences.push_back({MAX_VALUE, 0, MAX_VALUE - 1, 1, uint64_t{1} << 63});
+        for (size_t size : {1, 3, 4, 5, 127, 128, 129, 256, 1000}) {
+            std::vector<uint64_t> same(size, 42);
+            std::vector<uint64_t> random_lengths(size);
+            std::vector<uint64_t> timestamps(size);
+            std::vector<uint64_t> descending(size);
+            std::vector<uint64_t> extremes(size);
+            uint64_t time = 1700000000000 + random() % 1000;
+            for (size_t i = 0; i < size; ++i) {
+                random_lengths[i] = random() >> (random() % 64);
+                time += 1000 + random() % 3;
+                timestamps[i] = time;
+                descending[i] = MAX_VALUE - i * 12345;
+                extremes[i] = random() % 2 ? MAX_VALUE - random() % 3 : random() % 3;
+            }
+            sequences.push_back(same);
+            sequences.push_back(random_lengths);
+            sequences.push_back(timestamps);
+            sequences.push_back(descending);
+            sequences.push_back(extremes);
+        }
+        return sequences;
+    }
+
+    void TestRoundTrips() {
+        std::mt19937_64 random(1);
+        for (int round = 0; round < 20; ++round) {
+            std::vector<std::vector<uint64_t>> sequences = Sequences(random);
+            for (size_t codec = 0; codec < std::size(CODECS); ++codec) {
+                for (const std::vector<uint64_t> &values : sequences) {
+                    std::string name = std::string(CODEC_NAMES[codec]) + " of " + std::to_string(values.size());
+                    std::vector<uint8_t> encoded = {0xaa};  // EncodeBlock appends
+                    EncodeBlock(CODECS[codec], values, encoded);
+                    encoded.erase(encoded.begin());
+                    // An exactly sized copy, so the sanitizer sees any read past the end
+                    std::vector<uint8_t> exact(encoded);
+                    std::vector<uint64_t> decoded(values.size());
+                    Check(DecodeBlock(CODECS[codec], exact.data(), exact.size(), decoded) == exact.size(),
+                          name + ": consumed size");
+                    Check(decoded == values, name + ": values");
+
+                    size_t step = exact.size() < 64 ? 1 : exact.size() / 31;
+                    for (size_t cut = 0; cut < exact.size(); cut += step) {
+                        std::vector<uint8_t> truncated(exact.begin(), exact.begin() + cut);
+                        uint8_t unused;
+                        Check(DecodeBlock(CODECS[codec], cut == 0 ? &unused : truncated.data(), cut, decoded) == 0,
+                              name + ": truncated to " + std::to_string(cut));
+                    }
+                }
+            }
+        }
+    }
+
+    // Corrupted blocks may decode to anything, but must stay within the input
+    void TestCorruptedInput() {
+        std::mt19937_64 random(2);
+        for (int round = 0; round < 20000; ++round) {
+            size_t codec = random() % std::size(CODECS);
+            std::vector<uint64_t> values(1 + random() % 300);
+            for (uint64_t &value : values) {
+                value = random() >> (random() % 64);
+            }
+            std::vector<uint8_t> encoded;
+            EncodeBlock(CODECS[codec], values, encoded);
+            for (int flips = 0; flips < 3; ++flips) {
+                encoded[random() % encoded.size()] ^= static_cast<uint8_t>(1 << (random() % 8));
+            }
+            std::vector<uint64_t> decoded(values.size());
+            Check(DecodeBlock(CODECS[codec], encoded.data(), encoded.size(), decoded) <= encoded.size(),
+                  std::string(CODEC_NAMES[codec]) + ": corrupted input consumed at most its size");
+        }
+    }
+
+    // One value at a time with the DecodeVarint rules, for comparison with the bulk decoder
+    size_t DecodeVarintsReference(const uint8_t *data, size_t size, std::vector<uint64_t> &values) {
+        size_t offset = 0;
+        for (uint64_t &value : values) {
+            size_t length = 0;
+            while (length < MAX_VARINT_SIZE && offset + length < size && data[offset + length] >= 0x80) {
+                ++length;
+            }
+            if (length == MAX_VARINT_SIZE || offset + length == size) {
+                return 0;
+            }
+            ++length;
+            if (DecodeVarint(data + offset, length, value) != length) {
+                return 0;
+            }
+            offset += length;
+        }
+        return offset;
+    }
+
+    void TestDecodeVarintsAgainstReference() {
+        std::mt19937_64 random(3);
+        for (int round = 0; round < 100000; ++round) {
+            size_t count = random() % 80;
+            uint32_t max_shift = 1 + random() % 64;
+            std::vector<uint8_t> encoded;
+            for (size_t i = 0; i < count; ++i) {
+                uint8_t buffer[MAX_VARINT_SIZE];
+                size_t length = EncodeVarint(random() >> (64 - 1 - random() % max_shift), buffer);
+                encoded.insert(encoded.end(), buffer, buffer + length);
+            }
+            if (!encoded.empty() && random() % 3 == 0) {
+                encoded[random() % encoded.size()] ^= static_cast<uint8_t>(1 << (random() % 8));
+            }
+            if (count == 0 || encoded.empty()) {
+                continue;
+            }
+            std::vector<uint64_t> expected(count);
+            std::vector<uint64_t> decoded(count);
+            size_t expected_size = DecodeVarintsReference(encoded.data(), encoded.size(), expected);
+            size_t size = DecodeVarints(encoded.data(), encoded.size(), decoded);
+            Check(size == expected_size && (size == 0 || decoded == expected), "DecodeVarints matches DecodeVarint");
+        }
+    }
+
+    void TestZigZag() {
+        constexpr int64_t MIN = std::numeric_limits<int64_t>::min();
+        constexpr int64_t MAX = std::numeric_limits<int64_t>::max();
+        static_assert(ZigZagEncode(0) == 0 && ZigZagEncode(-1) == 1 && ZigZagEncode(1) == 2);
+        static_assert(ZigZagEncode(MIN) == MAX_VALUE && ZigZagEncode(MAX) == MAX_VALUE - 1);
+        std::mt19937_64 random(4);
+        for (int round = 0; round < 100000; ++round) {
+            int64_t value = static_cast<int64_t>(random()) >> (random() % 64);
+            Check(ZigZagDecode(ZigZagEncode(value)) == value, "ZigZag round trip");
+        }
+        Check(ZigZagDecode(ZigZagEncode(MIN)) == MIN && ZigZagDecode(ZigZagEncode(MAX)) == MAX, "ZigZag extremes");
+    }
+}
+
+int main() {
+    TestZigZag();
+    TestRoundTrips();
+    TestCorruptedInput();
+    TestDecodeVarintsAgainstReference();
+    return TestResult();
+}
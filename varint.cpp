@@ -1,9 +1,224 @@
 #include "varint.h"
+#include "bitops.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VARINT_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace {
-    constexpr size_t MAX_SIZE = 10;
+    constexpr size_t MAX_SIZE = MAX_VARINT_SIZE;
     constexpr size_t BITS_IN_BYTE = 8;
     constexpr size_t FIRST_BIT_MASK = 128;
+
+    // Decodes one value from a buffer of any size, returns the number of bytes consumed or 0
+    inline size_t DecodeOne(const uint8_t* data, size_t size, uint64_t& result) {
+        if (size > 0 && data[0] < FIRST_BIT_MASK) {
+            result = data[0];
+            return 1;
+        }
+        if (size > 1 && data[1] < FIRST_BIT_MASK) {
+            result = (data[0] & ~FIRST_BIT_MASK) | (static_cast<uint64_t>(data[1]) << (BITS_IN_BYTE - 1));
+            return 2;
+        }
+        uint64_t temp_result = 0;
+        size_t shift = 0;
+        size_t limit = size < MAX_SIZE ? size : MAX_SIZE;
+        for (size_t i = 0; i < limit; ++i) {
+            temp_result |= (data[i] & ~FIRST_BIT_MASK) << shift;
+            shift += BITS_IN_BYTE - 1;
+            if (!(data[i] & FIRST_BIT_MASK)) {
+                if (i == MAX_SIZE - 1 && data[i] > 1) {
+                    return 0;
+                }
+                result = temp_result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    size_t DecodeVarintsScalar(const uint8_t* data, size_t size, uint64_t* result, size_t count) {
+        size_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            size_t length = DecodeOne(data + offset, size - offset, result[i]);
+            if (length == 0) {
+                return 0;
+            }
+            offset += length;
+        }
+        return offset;
+    }
+
+#if defined(VARINT_X86_SIMD)
+    constexpr size_t WINDOW_SIZE = 16;
+    // Below this many values the window setup costs more than DecodeOne saves
+    constexpr size_t MIN_SIMD_COUNT = 16;
+    constexpr uint64_t PAYLOAD_BITS = 0x7f7f7f7f7f7f7f7f;
+    constexpr size_t SHUFFLE_MASK_BITS = 12;
+    constexpr size_t SHORT_VALUE_BYTES = 2;
+    constexpr size_t SHORT_VALUES_MAX = 8;
+    constexpr size_t MEDIUM_VALUE_BYTES = 4;
+    constexpr size_t MEDIUM_VALUES_MAX = 4;
+    constexpr char ZERO_BYTE = static_cast<char>(0x80);
+
+    // For every continuation-bit mask of 12 bytes: a pshufb pattern that spreads the leading
+    // values into lanes, how many values there are and how many bytes they take (masked
+    // VByte). Up to eight values of one or two bytes go into 16-bit lanes, up to four values
+    // of at most four bytes into 32-bit lanes, whichever decodes more values.
+    struct ShufflePattern {
+        char shuffle[WINDOW_SIZE];
+        uint8_t values;
+        uint8_t bytes;
+        uint8_t lane_bytes;
+    };
+
+    constexpr ShufflePattern BuildShufflePattern(size_t mask, size_t lane_bytes, size_t max_values) {
+        ShufflePattern pattern = {};
+        for (char& index : pattern.shuffle) {
+            index = ZERO_BYTE;
+        }
+        pattern.lane_bytes = static_cast<uint8_t>(lane_bytes);
+        size_t byte = 0;
+        while (pattern.values < max_values && byte < SHUFFLE_MASK_BITS) {
+            size_t length = 1;
+            while (mask & (size_t{1} << (byte + length - 1))) {
+                ++length;
+                if (length > lane_bytes || byte + length > SHUFFLE_MASK_BITS) {
+                    break;
+                }
+            }
+            if (length > lane_bytes || byte + length > SHUFFLE_MASK_BITS) {
+                break;
+            }
+            for (size_t i = 0; i < length; ++i) {
+                pattern.shuffle[lane_bytes * pattern.values + i] = static_cast<char>(byte + i);
+            }
+            ++pattern.values;
+            byte += length;
+        }
+        pattern.bytes = static_cast<uint8_t>(byte);
+        return pattern;
+    }
+
+    constexpr std::array<ShufflePattern, 1 << SHUFFLE_MASK_BITS> BuildShufflePatterns() {
+        std::array<ShufflePattern, 1 << SHUFFLE_MASK_BITS> patterns = {};
+        for (size_t mask = 0; mask < patterns.size(); ++mask) {
+            ShufflePattern short_values = BuildShufflePattern(mask, SHORT_VALUE_BYTES, SHORT_VALUES_MAX);
+            ShufflePattern medium_values = BuildShufflePattern(mask, MEDIUM_VALUE_BYTES, MEDIUM_VALUES_MAX);
+            patterns[mask] = medium_values.values > short_values.values ? medium_values : short_values;
+        }
+        return patterns;
+    }
+
+    constexpr std::array<ShufflePattern, 1 << SHUFFLE_MASK_BITS> SHUFFLE_PATTERNS = BuildShufflePatterns();
+
+    // The bytes taken by each pattern again, in a table small enough to stay in L1: the next
+    // window's offset depends on it, while the shuffle itself is off that critical path
+    constexpr std::array<uint8_t, 1 << SHUFFLE_MASK_BITS> BuildShuffleBytes() {
+        std::array<uint8_t, 1 << SHUFFLE_MASK_BITS> bytes = {};
+        for (size_t mask = 0; mask < bytes.size(); ++mask) {
+            bytes[mask] = SHUFFLE_PATTERNS[mask].bytes;
+        }
+        return bytes;
+    }
+
+    constexpr std::array<uint8_t, 1 << SHUFFLE_MASK_BITS> SHUFFLE_BYTES = BuildShuffleBytes();
+
+    // Finds the terminating bytes of a 16-byte window with one movemask. Leading values of up
+    // to four bytes are decoded four or eight at a time with a table-driven shuffle; longer
+    // values have their 7-bit payloads gathered with pext. A window made only of one-byte
+    // values is widened to 64 bits directly.
+    __attribute__((target("avx2,bmi,bmi2")))
+    size_t DecodeVarintsAvx2(const uint8_t* data, size_t size, uint64_t* result, size_t count) {
+        size_t offset = 0;
+        size_t produced = 0;
+        while (produced < count && offset + 2 * WINDOW_SIZE <= size) {
+            __m128i window = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+            uint32_t terminators = ~static_cast<uint32_t>(_mm_movemask_epi8(window)) & 0xffff;
+            if (terminators == 0xffff && count - produced >= WINDOW_SIZE) {
+                for (size_t i = 0; i < WINDOW_SIZE; i += 4) {
+                    __m256i values = _mm256_cvtepu8_epi64(window);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + produced + i), values);
+                    window = _mm_srli_si128(window, 4);
+                }
+                offset += WINDOW_SIZE;
+                produced += WINDOW_SIZE;
+                continue;
+            }
+            uint32_t mask = ~terminators & ((1u << SHUFFLE_MASK_BITS) - 1);
+            const ShufflePattern& pattern = SHUFFLE_PATTERNS[mask];
+            if (SHUFFLE_BYTES[mask] > 0 && count - produced >= WINDOW_SIZE / pattern.lane_bytes) {
+                __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.shuffle));
+                __m128i lanes = _mm_shuffle_epi8(window, shuffle);
+                // Every step joins neighbouring 7-bit groups: the upper one moves down over
+                // the continuation bit of the lower one
+                __m128i values = _mm_or_si128(_mm_and_si128(lanes, _mm_set1_epi16(0x7f)),
+                                              _mm_and_si128(_mm_srli_epi16(lanes, 1), _mm_set1_epi16(0x3f80)));
+                if (pattern.lane_bytes == SHORT_VALUE_BYTES) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + produced), _mm256_cvtepu16_epi64(values));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + produced + 4),
+                                        _mm256_cvtepu16_epi64(_mm_srli_si128(values, 8)));
+                } else {
+                    values = _mm_or_si128(_mm_and_si128(values, _mm_set1_epi32(0x3fff)),
+                                          _mm_and_si128(_mm_srli_epi32(values, 2), _mm_set1_epi32(0xfffc000)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + produced), _mm256_cvtepu32_epi64(values));
+                }
+                offset += SHUFFLE_BYTES[mask];
+                produced += pattern.values;
+                continue;
+            }
+            if (terminators == 0) {
+                return 0;
+            }
+            size_t start = 0;
+            while (terminators != 0 && produced < count) {
+                size_t length = _tzcnt_u32(terminators) + 1 - start;
+                const uint8_t* value_data = data + offset + start;
+                uint64_t low;
+                std::memcpy(&low, value_data, sizeof(low));
+                if (length <= BITS_IN_BYTE) {
+                    result[produced] = _pext_u64(_bzhi_u64(low, length * BITS_IN_BYTE), PAYLOAD_BITS);
+                } else {
+                    if (length > MAX_SIZE || (length == MAX_SIZE && value_data[MAX_SIZE - 1] > 1)) {
+                        return 0;
+                    }
+                    uint64_t high;
+                    std::memcpy(&high, value_data + BITS_IN_BYTE, sizeof(high));
+                    high = _pext_u64(_bzhi_u64(high, (length - BITS_IN_BYTE) * BITS_IN_BYTE), PAYLOAD_BITS);
+                    result[produced] = _pext_u64(low, PAYLOAD_BITS) | (high << (BITS_IN_BYTE * (BITS_IN_BYTE - 1)));
+                }
+                start += length;
+                terminators &= terminators - 1;
+                ++produced;
+            }
+            offset += start;
+        }
+        size_t tail = DecodeVarintsScalar(data + offset, size - offset, result + produced, count - produced);
+        if (tail == 0 && produced < count) {
+            return 0;
+        }
+        return offset + tail;
+    }
+#endif
+}
+
+size_t VarintLength(uint64_t value) {
+    size_t significant_bits = BITS_IN_BYTE * sizeof(value) - CountLeadingZeros(value | 1);
+    return (significant_bits + BITS_IN_BYTE - 2) / (BITS_IN_BYTE - 1);
+}
+
+size_t EncodeVarint(uint64_t value, uint8_t* data) {
+    size_t length = VarintLength(value);
+    for (size_t i = 0; i + 1 < length; ++i) {
+        data[i] = static_cast<uint8_t>(value | FIRST_BIT_MASK);
+        value >>= BITS_IN_BYTE - 1;
+    }
+    data[length - 1] = static_cast<uint8_t>(value);
+    return length;
 }
 
 size_t DecodeVarint(const uint8_t* data, size_t size, uint64_t& result) {
@@ -25,3 +240,237 @@ size_t DecodeVarint(const uint8_t* data, size_t size, uint64_t& result) {
     }
     return 0;
 }
+
+size_t DecodeVarints(const uint8_t* data, size_t size, std::span<uint64_t> result) {
+    if (data == nullptr || result.empty()) {
+        return 0;
+    }
+#if defined(VARINT_X86_SIMD)
+    if (result.size() >= MIN_SIMD_COUNT && GetCpuFeatures().avx2 && GetCpuFeatures().bmi2) {
+        return DecodeVarintsAvx2(data, size, result.data(), result.size());
+    }
+#endif
+    return DecodeVarintsScalar(data, size, result.data(), result.size());
+}
+
+namespace {
+    constexpr size_t GROUP_SIZE = 4;
+    constexpr size_t GROUP_CODE_BITS = 2;
+    constexpr size_t GROUP_LENGTHS[] = {1, 2, 4, 8};
+    // Slack after a bit-packed frame that lets it be read with unaligned 8-byte loads
+    constexpr size_t PACKED_PADDING = 2 * sizeof(uint64_t);
+
+    void AppendVarints(std::span<const uint64_t> values, std::vector<uint8_t>& out) {
+        size_t offset = out.size();
+        out.resize(offset + values.size() * MAX_SIZE);
+        for (uint64_t value : values) {
+            offset += EncodeVarint(value, out.data() + offset);
+        }
+        out.resize(offset);
+    }
+
+    uint64_t LoadWord(const uint8_t* data) {
+        uint64_t result;
+        std::memcpy(&result, data, sizeof(result));
+        if constexpr (std::endian::native == std::endian::big) {
+            result = SwapBytes(result);
+        }
+        return result;
+    }
+
+    void StoreWord(uint64_t value, uint8_t* data) {
+        if constexpr (std::endian::native == std::endian::big) {
+            value = SwapBytes(value);
+        }
+        std::memcpy(data, &value, sizeof(value));
+    }
+
+    uint64_t LoadLittleEndian(const uint8_t* data, size_t length) {
+        uint64_t result = 0;
+        for (size_t i = 0; i < length; ++i) {
+            result |= static_cast<uint64_t>(data[i]) << (BITS_IN_BYTE * i);
+        }
+        return result;
+    }
+
+    void StoreLittleEndian(uint64_t value, uint8_t* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = static_cast<uint8_t>(value >> (BITS_IN_BYTE * i));
+        }
+    }
+
+    void EncodeDelta(std::span<const uint64_t> values, std::vector<uint8_t>& out, bool of_delta) {
+        if (values.empty()) {
+            return;
+        }
+        size_t offset = out.size();
+        out.resize(offset + values.size() * MAX_SIZE);
+        offset += EncodeVarint(values[0], out.data() + offset);
+        uint64_t previous_delta = 0;
+        for (size_t i = 1; i < values.size(); ++i) {
+            uint64_t delta = values[i] - values[i - 1];
+            uint64_t encoded = of_delta ? delta - previous_delta : delta;
+            offset += EncodeVarint(ZigZagEncode(static_cast<int64_t>(encoded)), out.data() + offset);
+            previous_delta = delta;
+        }
+        out.resize(offset);
+    }
+
+    size_t DecodeDelta(const uint8_t* data, size_t size, std::span<uint64_t> values, bool of_delta) {
+        size_t length = DecodeVarints(data, size, values);
+        if (length == 0) {
+            return 0;
+        }
+        uint64_t delta = 0;
+        for (size_t i = 1; i < values.size(); ++i) {
+            uint64_t decoded = static_cast<uint64_t>(ZigZagDecode(values[i]));
+            delta = of_delta ? delta + decoded : decoded;
+            values[i] = values[i - 1] + delta;
+        }
+        return length;
+    }
+
+    void EncodeGroupVarint(std::span<const uint64_t> values, std::vector<uint8_t>& out) {
+        size_t offset = out.size();
+        size_t groups = (values.size() + GROUP_SIZE - 1) / GROUP_SIZE;
+        out.resize(offset + groups + values.size() * sizeof(uint64_t));
+        for (size_t group = 0; group < values.size(); group += GROUP_SIZE) {
+            uint8_t& control = out[offset++];
+            control = 0;
+            for (size_t i = 0; i < GROUP_SIZE && group + i < values.size(); ++i) {
+                uint64_t value = values[group + i];
+                size_t bytes = (BITS_IN_BYTE * sizeof(value) - CountLeadingZeros(value | 1) + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+                size_t code = bytes <= 1 ? 0 : bytes <= 2 ? 1 : bytes <= 4 ? 2 : 3;
+                control |= static_cast<uint8_t>(code << (GROUP_CODE_BITS * i));
+                StoreLittleEndian(value, out.data() + offset, GROUP_LENGTHS[code]);
+                offset += GROUP_LENGTHS[code];
+            }
+        }
+        out.resize(offset);
+    }
+
+    size_t DecodeGroupVarint(const uint8_t* data, size_t size, std::span<uint64_t> values) {
+        size_t offset = 0;
+        for (size_t group = 0; group < values.size(); group += GROUP_SIZE) {
+            if (offset >= size) {
+                return 0;
+            }
+            uint8_t control = data[offset++];
+            for (size_t i = 0; i < GROUP_SIZE && group + i < values.size(); ++i) {
+                size_t length = GROUP_LENGTHS[(control >> (GROUP_CODE_BITS * i)) & 3];
+                if (size - offset >= sizeof(uint64_t)) {
+                    uint64_t word = LoadWord(data + offset);
+                    values[group + i] = ExtractBits(word, 0, length * BITS_IN_BYTE);
+                } else if (size - offset >= length) {
+                    values[group + i] = LoadLittleEndian(data + offset, length);
+                } else {
+                    return 0;
+                }
+                offset += length;
+            }
+        }
+        return offset;
+    }
+
+    void EncodeFrameOfReference(std::span<const uint64_t> values, std::vector<uint8_t>& out) {
+        for (size_t frame = 0; frame < values.size(); frame += FRAME_OF_REFERENCE_SIZE) {
+            std::span<const uint64_t> frame_values = values.subspan(frame, std::min(FRAME_OF_REFERENCE_SIZE, values.size() - frame));
+            uint64_t min = frame_values[0];
+            uint64_t max = frame_values[0];
+            for (uint64_t value : frame_values) {
+                min = value < min ? value : min;
+                max = value > max ? value : max;
+            }
+            uint64_t width = max == min ? 0 : BITS_IN_BYTE * sizeof(uint64_t) - CountLeadingZeros(max - min);
+            AppendVarints(std::span<const uint64_t>(&min, 1), out);
+            out.push_back(static_cast<uint8_t>(width));
+
+            size_t offset = out.size();
+            size_t packed_bytes = (frame_values.size() * width + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+            out.resize(offset + packed_bytes + PACKED_PADDING, 0);
+            uint8_t* packed = out.data() + offset;
+            for (size_t i = 0; i < frame_values.size() && width > 0; ++i) {
+                size_t bit = i * width;
+                uint64_t value = frame_values[i] - min;
+                uint64_t word = LoadWord(packed + bit / BITS_IN_BYTE);
+                StoreWord(word | (value << (bit % BITS_IN_BYTE)), packed + bit / BITS_IN_BYTE);
+                if (bit % BITS_IN_BYTE + width > BITS_IN_BYTE * sizeof(uint64_t)) {
+                    packed[bit / BITS_IN_BYTE + sizeof(uint64_t)] |=
+                        static_cast<uint8_t>(value >> (BITS_IN_BYTE * sizeof(uint64_t) - bit % BITS_IN_BYTE));
+                }
+            }
+            out.resize(offset + packed_bytes);
+        }
+    }
+
+    size_t DecodeFrameOfReference(const uint8_t* data, size_t size, std::span<uint64_t> values) {
+        size_t offset = 0;
+        uint8_t padded[FRAME_OF_REFERENCE_SIZE * sizeof(uint64_t) + PACKED_PADDING];
+        for (size_t frame = 0; frame < values.size(); frame += FRAME_OF_REFERENCE_SIZE) {
+            std::span<uint64_t> frame_values = values.subspan(frame, std::min(FRAME_OF_REFERENCE_SIZE, values.size() - frame));
+            uint64_t min = 0;
+            size_t length = DecodeVarints(data + offset, size - offset, std::span<uint64_t>(&min, 1));
+            if (length == 0 || offset + length >= size) {
+                return 0;
+            }
+            offset += length;
+            uint64_t width = data[offset++];
+            size_t packed_bytes = (frame_values.size() * width + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+            if (width > BITS_IN_BYTE * sizeof(uint64_t) || size - offset < packed_bytes) {
+                return 0;
+            }
+            // Near the end of the input the frame is copied so that the 8-byte loads stay in bounds
+            const uint8_t* packed = data + offset;
+            if (size - offset < packed_bytes + PACKED_PADDING) {
+                std::memcpy(padded, packed, packed_bytes);
+                std::memset(padded + packed_bytes, 0, PACKED_PADDING);
+                packed = padded;
+            }
+            for (size_t i = 0; i < frame_values.size(); ++i) {
+                size_t bit = i * width;
+                uint64_t value = LoadWord(packed + bit / BITS_IN_BYTE) >> (bit % BITS_IN_BYTE);
+                if (bit % BITS_IN_BYTE + width > BITS_IN_BYTE * sizeof(uint64_t)) {
+                    value |= static_cast<uint64_t>(packed[bit / BITS_IN_BYTE + sizeof(uint64_t)])
+                             << (BITS_IN_BYTE * sizeof(uint64_t) - bit % BITS_IN_BYTE);
+                }
+                frame_values[i] = min + ExtractBits(value, 0, width);
+            }
+            offset += packed_bytes;
+        }
+        return offset;
+    }
+}
+
+void EncodeBlock(IntegerCodec codec, std::span<const uint64_t> values, std::vector<uint8_t>& out) {
+    switch (codec) {
+        case IntegerCodec::Varint:
+            return AppendVarints(values, out);
+        case IntegerCodec::Delta:
+            return EncodeDelta(values, out, false);
+        case IntegerCodec::DeltaOfDelta:
+            return EncodeDelta(values, out, true);
+        case IntegerCodec::GroupVarint:
+            return EncodeGroupVarint(values, out);
+        case IntegerCodec::FrameOfReference:
+            return EncodeFrameOfReference(values, out);
+    }
+}
+
+size_t DecodeBlock(IntegerCodec codec, const uint8_t* data, size_t size, std::span<uint64_t> values) {
+    if (data == nullptr || values.empty()) {
+        return 0;
+    }
+    switch (codec) {
+        case IntegerCodec::Varint:
+            return DecodeVarints(data, size, values);
+        case IntegerCodec::Delta:
+            return DecodeDelta(data, size, values, false);
+        case IntegerCodec::DeltaOfDelta:
+            return DecodeDelta(data, size, values, true);
+        case IntegerCodec::GroupVarint:
+            return DecodeGroupVarint(data, size, values);
+        case IntegerCodec::FrameOfReference:
+            return DecodeFrameOfReference(data, size, values);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+constexpr size_t MAX_VARINT_SIZE = 10;
+
+// Number of bytes EncodeVarint produces for the value
+size_t VarintLength(uint64_t value);
+// Writes the LEB128 encoding of the value, `data` needs room for VarintLength(value) bytes.
+// Returns the number of bytes written.
+size_t EncodeVarint(uint64_t value, uint8_t* data);
+
+// Decodes a single LEB128 value from a buffer of at most 10 bytes.
+// Returns the number of bytes consumed, 0 if the input is malformed or truncated.
+size_t DecodeVarint(const uint8_t* data, size_t size, uint64_t& result);
+
+// Decodes exactly result.size() consecutive values. Every value obeys the DecodeVarint rules
+// (at most 10 bytes, the 10th byte at most 1), but `size` may span any number of values.
+// Returns the number of bytes consumed, 0 if the input is malformed or ends too early.
+// Values of up to four bytes are decoded several per shuffle. Each window's offset depends on
+// the previous one, so this stays well below billions of values per second except on one-byte
+// runs: see benchmarks/varint_benchmark.cpp for the rates per length mix.
+size_t DecodeVarints(const uint8_t* data, size_t size, std::span<uint64_t> result);
+
+// Maps signed values to unsigned ones so that small magnitudes get short encodings
+constexpr uint64_t ZigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr int64_t ZigZagDecode(uint64_t value) {
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+enum class IntegerCodec {
+    Varint,            // LEB128 per value
+    Delta,             // First value, then ZigZag varint differences; for sorted sequences
+    DeltaOfDelta,      // First value, then ZigZag varint differences of differences; for timestamps
+    GroupVarint,       // A control byte per four values, each stored in 1, 2, 4 or 8 bytes
+    FrameOfReference,  // Frames of 128 values: minimum plus fixed-width bit-packed offsets
+};
+
+constexpr size_t FRAME_OF_REFERENCE_SIZE = 128;
+
+// Appends the encoding of `values` to `out`. The number of values is not stored: the block
+// is decoded back with DecodeBlock into a span of the same size.
+void EncodeBlock(IntegerCodec codec, std::span<const uint64_t> values, std::vector<uint8_t>& out);
+// Decodes exactly values.size() values. Returns the number of bytes consumed, 0 if the input
+// is malformed or ends too early.
+size_t DecodeBlock(IntegerCodec codec, const uint8_t* data, size_t size, std::span<uint64_t> values);
@@ -0,0 +1,197 @@
+#include "varint_stream.h"
+#include "varint.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+    constexpr uint8_t FIRST_BIT_MASK = 128;
+
+    constexpr size_t COUNT_BLOCK_SIZE = 64;
+
+    // Every byte without the continuation bit ends a value. Counting stops at `limit`, so a
+    // batch only scans the bytes of the values it decodes, not all the buffered input.
+    size_t CountTerminators(const uint8_t* data, size_t size, size_t limit) {
+        size_t result = 0;
+        size_t i = 0;
+        // Whole blocks cannot overshoot the limit and their loop is vectorized
+        for (; i + COUNT_BLOCK_SIZE <= size && result + COUNT_BLOCK_SIZE <= limit; i += COUNT_BLOCK_SIZE) {
+            for (size_t j = 0; j < COUNT_BLOCK_SIZE; ++j) {
+                result += data[i + j] < FIRST_BIT_MASK;
+            }
+        }
+        for (; i < size && result < limit; ++i) {
+            result += data[i] < FIRST_BIT_MASK;
+        }
+        return result;
+    }
+}
+
+VarintReader::VarintReader(int fd, size_t buffer_size) : fd_(fd), buffer_(buffer_size) {
+    if (buffer_size < MAX_VARINT_SIZE) {
+        throw std::invalid_argument("VarintReader: buffer is too small");
+    }
+    pos_ = buffer_.data();
+    end_ = buffer_.data();
+}
+
+VarintReader::VarintReader(const uint8_t* data, size_t size) : eof_(true), pos_(data), end_(data + size) {
+
+}
+
+size_t VarintReader::Available() const {
+    return static_cast<size_t>(end_ - pos_);
+}
+
+void VarintReader::Fill() {
+    if (eof_) {
+        return;
+    }
+    size_t tail = Available();
+    std::memmove(buffer_.data(), pos_, tail);
+    pos_ = buffer_.data();
+    end_ = buffer_.data() + tail;
+    while (!eof_ && Available() < MAX_VARINT_SIZE) {
+        ssize_t count = ::read(fd_, buffer_.data() + Available(), buffer_.size() - Available());
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "VarintReader::Fill");
+        }
+        if (count == 0) {
+            eof_ = true;
+        }
+        end_ += count;
+    }
+}
+
+bool VarintReader::Read(uint64_t& value) {
+    if (failed_) {
+        return false;
+    }
+    if (Available() < MAX_VARINT_SIZE) {
+        Fill();
+    }
+    if (Available() == 0) {
+        return false;
+    }
+    size_t length = DecodeVarints(pos_, Available(), std::span<uint64_t>(&value, 1));
+    if (length == 0) {
+        failed_ = true;
+        return false;
+    }
+    pos_ += length;
+    return true;
+}
+
+size_t VarintReader::ReadBatch(std::span<uint64_t> values) {
+    size_t done = 0;
+    while (done < values.size() && !failed_) {
+        // Decode every value that is complete in the buffer with a single bulk call
+        size_t count = CountTerminators(pos_, Available(), values.size() - done);
+        if (count == 0) {
+            // No value is longer than MAX_VARINT_SIZE, so a full window without an end is malformed
+            if (eof_ || Available() >= MAX_VARINT_SIZE) {
+                failed_ = Available() > 0;
+                break;
+            }
+            Fill();
+            continue;
+        }
+        size_t length = DecodeVarints(pos_, Available(), values.subspan(done, count));
+        if (length == 0) {
+            failed_ = true;
+            break;
+        }
+        pos_ += length;
+        done += count;
+    }
+    return done;
+}
+
+bool VarintReader::Failed() const {
+    return failed_;
+}
+
+VarintWriter::VarintWriter(int fd, size_t buffer_size) : fd_(fd), buffer_(buffer_size) {
+    if (buffer_size < MAX_VARINT_SIZE) {
+        throw std::invalid_argument("VarintWriter: buffer is too small");
+    }
+    begin_ = buffer_.data();
+    pos_ = buffer_.data();
+    end_ = buffer_.data() + buffer_.size();
+}
+
+VarintWriter::VarintWriter(uint8_t* data, size_t size) : begin_(data), pos_(data), end_(data + size) {
+
+}
+
+VarintWriter::~VarintWriter() {
+    try {
+        Flush();
+    } catch (...) {
+        // Destructors must not throw; call Flush() explicitly to observe write errors
+    }
+}
+
+size_t VarintWriter::Free() const {
+    return static_cast<size_t>(end_ - pos_);
+}
+
+bool VarintWriter::Write(uint64_t value) {
+    if (Free() < MAX_VARINT_SIZE) {
+        Flush();
+        if (Free() < VarintLength(value)) {
+            return false;
+        }
+    }
+    pos_ += EncodeVarint(value, pos_);
+    return true;
+}
+
+bool VarintWriter::WriteBatch(std::span<const uint64_t> values) {
+    size_t done = 0;
+    while (done < values.size()) {
+        // As many values as surely fit are encoded without any bounds checks
+        size_t count = std::min(values.size() - done, Free() / MAX_VARINT_SIZE);
+        if (count == 0) {
+            if (!Write(values[done])) {
+                return false;
+            }
+            ++done;
+            continue;
+        }
+        for (size_t i = done; i < done + count; ++i) {
+            pos_ += EncodeVarint(values[i], pos_);
+        }
+        done += count;
+    }
+    return true;
+}
+
+void VarintWriter::Flush() {
+    if (fd_ < 0) {
+        return;
+    }
+    const uint8_t* data = begin_;
+    while (data < pos_) {
+        ssize_t count = ::write(fd_, data, static_cast<size_t>(pos_ - data));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "VarintWriter::Flush");
+        }
+        data += count;
+    }
+    flushed_ += static_cast<uint64_t>(pos_ - begin_);
+    pos_ = begin_;
+}
+
+uint64_t VarintWriter::BytesWritten() const {
+    return flushed_ + static_cast<uint64_t>(pos_ - begin_);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Reads LEB128 values either from a file descriptor through a fixed-size buffer or straight
+// from a memory region (e.g. an mmapped file) without any copying. A value split between two
+// reads is carried over to the front of the buffer, which is the only data ever moved.
+class VarintReader {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    // The descriptor stays owned by the caller
+    explicit VarintReader(int fd, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    VarintReader(const uint8_t* data, size_t size);
+
+    VarintReader(const VarintReader&) = delete;
+    VarintReader& operator=(const VarintReader&) = delete;
+
+    // Returns false at the end of the input or on malformed data, see Failed()
+    bool Read(uint64_t& value);
+    // Returns the number of values read, less than values.size() only at the end or on failure
+    size_t ReadBatch(std::span<uint64_t> values);
+    bool Failed() const;
+
+private:
+    int fd_ = -1;
+    bool eof_ = false;
+    bool failed_ = false;
+    std::vector<uint8_t> buffer_;
+    const uint8_t* pos_ = nullptr;
+    const uint8_t* end_ = nullptr;
+
+    size_t Available() const;
+    void Fill();
+};
+
+// Writes LEB128 values to a file descriptor through a fixed-size buffer or straight into a
+// memory region. Values are always encoded in place, never into a temporary.
+class VarintWriter {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    // The descriptor stays owned by the caller; pending data is flushed on destruction
+    explicit VarintWriter(int fd, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    VarintWriter(uint8_t* data, size_t size);
+    ~VarintWriter();
+
+    VarintWriter(const VarintWriter&) = delete;
+    VarintWriter& operator=(const VarintWriter&) = delete;
+
+    // Returns false if a memory region has no room left for the value
+    bool Write(uint64_t value);
+    bool WriteBatch(std::span<const uint64_t> values);
+    void Flush();
+    // Total bytes encoded so far, flushed or not
+    uint64_t BytesWritten() const;
+
+private:
+    int fd_ = -1;
+    std::vector<uint8_t> buffer_;
+    uint8_t* begin_ = nullptr;
+    uint8_t* pos_ = nullptr;
+    uint8_t* end_ = nullptr;
+    uint64_t flushed_ = 0;
+
+    size_t Free() const;
+};